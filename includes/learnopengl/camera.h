@@ -68,6 +68,30 @@ public:
         return glm::lookAt(Position, Position + Front, Up);
     }
 
+    // returns the perspective projection for the current zoom
+    glm::mat4 GetProjectionMatrix(float aspect, float nearPlane, float farPlane) const
+    {
+        return glm::perspective(glm::radians(Zoom), aspect, nearPlane, farPlane);
+    }
+
+    // extracts the planes of the view frustum from a view-projection matrix, in the order left, right, bottom, top,
+    // near, far. Each plane is (normal, distance) with the normal pointing into the frustum and of unit length, so
+    // dot(plane, vec4(p, 1.0)) is the signed distance of p from it, negative outside.
+    static void ExtractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+    {
+        // rows of the matrix; glm stores it column by column
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; i++)
+            rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+        for (int i = 0; i < 3; i++)
+        {
+            planes[2 * i] = rows[3] + rows[i];
+            planes[2 * i + 1] = rows[3] - rows[i];
+        }
+        for (int i = 0; i < 6; i++)
+            planes[i] /= glm::length(glm::vec3(planes[i]));
+    }
+
     // processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
     void ProcessKeyboard(Camera_Movement direction, float deltaTime)
     {
@@ -0,0 +1,148 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+// Thin state-tracking layer over the GL calls used for drawing. Each call is only forwarded to the driver
+// when it actually changes the current state; redundant ones are dropped and counted.
+// Code that changes any of this state with raw GL calls has to call invalidate() afterwards.
+class GLState
+{
+public:
+    static const unsigned int MAX_TEXTURE_UNITS = 32;
+
+    // activate a program object
+    // ------------------------------------------------------------------------
+    static void useProgram(GLuint program)
+    {
+        State &s = state();
+        if (s.program == program) { s.filtered++; return; }
+        s.program = program;
+        s.issued++;
+        glUseProgram(program);
+    }
+    // delete a program object, GL keeps using it until another program is activated
+    // ------------------------------------------------------------------------
+    static void deleteProgram(GLuint program)
+    {
+        State &s = state();
+        if (s.program == program)
+        {
+            s.program = 0;
+            glUseProgram(0);
+        }
+        glDeleteProgram(program);
+    }
+    // bind a vertex array object
+    // ------------------------------------------------------------------------
+    static void bindVertexArray(GLuint vao)
+    {
+        State &s = state();
+        if (s.vertexArray == vao) { s.filtered++; return; }
+        s.vertexArray = vao;
+        s.issued++;
+        glBindVertexArray(vao);
+    }
+    // delete a vertex array object, GL falls back to VAO 0 if it was bound
+    // ------------------------------------------------------------------------
+    static void deleteVertexArray(GLuint vao)
+    {
+        State &s = state();
+        if (s.vertexArray == vao)
+            s.vertexArray = 0;
+        glDeleteVertexArrays(1, &vao);
+    }
+    // select the active texture unit
+    // ------------------------------------------------------------------------
+    static void activeTexture(GLenum unit)
+    {
+        State &s = state();
+        if (s.activeUnit == unit) { s.filtered++; return; }
+        s.activeUnit = unit;
+        s.issued++;
+        glActiveTexture(unit);
+    }
+    // bind a texture to the active texture unit. Only 2D, 2D array and cube map textures are tracked.
+    // ------------------------------------------------------------------------
+    static void bindTexture(GLenum target, GLuint texture)
+    {
+        State &s = state();
+        int slot = targetSlot(target);
+        unsigned int unit = s.activeUnit - GL_TEXTURE0;
+        if (slot >= 0 && unit < MAX_TEXTURE_UNITS)
+        {
+            if (s.textures[unit][slot] == texture) { s.filtered++; return; }
+            s.textures[unit][slot] = texture;
+        }
+        s.issued++;
+        glBindTexture(target, texture);
+    }
+    // set the polygon rasterization mode of both faces (the only one the core profile allows)
+    // ------------------------------------------------------------------------
+    static void polygonMode(GLenum mode)
+    {
+        State &s = state();
+        if (s.polygonMode == mode) { s.filtered++; return; }
+        s.polygonMode = mode;
+        s.issued++;
+        glPolygonMode(GL_FRONT_AND_BACK, mode);
+    }
+    // forget everything that is tracked, the next call of each kind goes to the driver again
+    // ------------------------------------------------------------------------
+    static void invalidate()
+    {
+        State &s = state();
+        unsigned int filtered = s.filtered, issued = s.issued;
+        s = State();
+        s.filtered = filtered;
+        s.issued = issued;
+    }
+    // statistics: state changes dropped as redundant and forwarded to the driver since the last resetCounters()
+    // ------------------------------------------------------------------------
+    static unsigned int getFilteredCalls() { return state().filtered; }
+    static unsigned int getIssuedCalls()   { return state().issued; }
+    static void resetCounters()
+    {
+        state().filtered = 0;
+        state().issued = 0;
+    }
+
+private:
+    static const GLuint UNKNOWN = 0xFFFFFFFFu;
+
+    struct State {
+        GLuint program;
+        GLuint vertexArray;
+        GLenum activeUnit;
+        GLenum polygonMode;
+        GLuint textures[MAX_TEXTURE_UNITS][3];
+        unsigned int filtered;
+        unsigned int issued;
+
+        // everything starts out unknown, so the first call of each kind always reaches the driver
+        State() : program(UNKNOWN), vertexArray(UNKNOWN), activeUnit(UNKNOWN), polygonMode(UNKNOWN), filtered(0), issued(0)
+        {
+            for (unsigned int i = 0; i < MAX_TEXTURE_UNITS; i++)
+                for (unsigned int j = 0; j < 3; j++)
+                    textures[i][j] = UNKNOWN;
+        }
+    };
+
+    static State &state()
+    {
+        static State s;
+        return s;
+    }
+
+    static int targetSlot(GLenum target)
+    {
+        switch (target)
+        {
+            case GL_TEXTURE_2D:       return 0;
+            case GL_TEXTURE_2D_ARRAY: return 1;
+            case GL_TEXTURE_CUBE_MAP: return 2;
+            default:                  return -1;
+        }
+    }
+};
+#endif
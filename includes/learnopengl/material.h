@@ -0,0 +1,136 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+#include <stb_image.h>
+
+#include <learnopengl/gl_state.h>
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+// the per-mesh material: which layers of its model's texture array it samples from (-1 if it has no such map)
+// and the diffuse color, which tints the diffuse map or replaces it when there is none
+struct Material {
+    int diffuseLayer  = -1;
+    int specularLayer = -1;
+    glm::vec3 diffuseColor = glm::vec3(1.0f);
+};
+
+// packs all textures of a model into the layers of a single GL_TEXTURE_2D_ARRAY, so that every mesh
+// of the model can be drawn with one texture bind. Images of different sizes are resized to the largest one.
+class TextureArray
+{
+public:
+    unsigned int ID = 0;
+    int width  = 0;
+    int height = 0;
+
+    // decodes an image and queues it as the next layer. Returns the layer index, or -1 if the image failed to load.
+    int addImage(const std::string &filename)
+    {
+        int w, h, nrComponents;
+        unsigned char *data = stbi_load(filename.c_str(), &w, &h, &nrComponents, 4); // always expand to RGBA so all layers share one format
+        if (!data)
+        {
+            std::cout << "Texture failed to load at path: " << filename << std::endl;
+            return -1;
+        }
+        Image image;
+        image.width = w;
+        image.height = h;
+        image.pixels.assign(data, data + w * h * 4);
+        stbi_image_free(data);
+
+        if (w > width)  width = w;
+        if (h > height) height = h;
+        images.push_back(image);
+        return (int)(layers++);
+    }
+
+    // uploads all queued layers to the GPU and frees the decoded images
+    void build()
+    {
+        if (images.empty())
+            return;
+
+        glGenTextures(1, &ID);
+        GLState::bindTexture(GL_TEXTURE_2D_ARRAY, ID);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        std::vector<unsigned char> resized;
+        for (unsigned int i = 0; i < images.size(); i++)
+        {
+            const unsigned char *pixels = &images[i].pixels[0];
+            if (images[i].width != width || images[i].height != height)
+            {
+                resize(images[i], width, height, resized);
+                pixels = &resized[0];
+            }
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        }
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        images.clear();
+        images.shrink_to_fit();
+    }
+
+    unsigned int getLayerCount() const
+    {
+        return layers;
+    }
+
+private:
+    struct Image {
+        int width;
+        int height;
+        std::vector<unsigned char> pixels; // RGBA8
+    };
+    std::vector<Image> images;
+    unsigned int layers = 0;
+
+    // bilinear resample of an RGBA8 image to the given size
+    static void resize(const Image &src, int dstWidth, int dstHeight, std::vector<unsigned char> &dst)
+    {
+        dst.resize(dstWidth * dstHeight * 4);
+        float sx = (float)src.width / (float)dstWidth;
+        float sy = (float)src.height / (float)dstHeight;
+        for (int y = 0; y < dstHeight; y++)
+        {
+            // sample at texel centers so that up- and downscaling both stay aligned
+            float fy = (y + 0.5f) * sy - 0.5f;
+            if (fy < 0.0f) fy = 0.0f;
+            int y0 = (int)fy;
+            int y1 = y0 + 1 < src.height ? y0 + 1 : y0;
+            float ty = fy - y0;
+            for (int x = 0; x < dstWidth; x++)
+            {
+                float fx = (x + 0.5f) * sx - 0.5f;
+                if (fx < 0.0f) fx = 0.0f;
+                int x0 = (int)fx;
+                int x1 = x0 + 1 < src.width ? x0 + 1 : x0;
+                float tx = fx - x0;
+
+                const unsigned char *p00 = &src.pixels[(y0 * src.width + x0) * 4];
+                const unsigned char *p10 = &src.pixels[(y0 * src.width + x1) * 4];
+                const unsigned char *p01 = &src.pixels[(y1 * src.width + x0) * 4];
+                const unsigned char *p11 = &src.pixels[(y1 * src.width + x1) * 4];
+                unsigned char *out = &dst[(y * dstWidth + x) * 4];
+                for (int c = 0; c < 4; c++)
+                {
+                    float top    = p00[c] + (p10[c] - p00[c]) * tx;
+                    float bottom = p01[c] + (p11[c] - p01[c]) * tx;
+                    out[c] = (unsigned char)(top + (bottom - top) * ty + 0.5f);
+                }
+            }
+        }
+    }
+};
+#endif
@@ -7,6 +7,8 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <learnopengl/shader_variants.h>
+#include <learnopengl/material.h>
 
 #include <string>
 #include <vector>
@@ -25,9 +27,16 @@ struct Vertex {
     glm::vec3 Bitangent;
 };
 
+enum TextureType {
+    TEXTURE_DIFFUSE,
+    TEXTURE_SPECULAR,
+    TEXTURE_NORMAL,
+    TEXTURE_HEIGHT
+};
+
 struct Texture {
-    unsigned int id;
-    string type;
+    int layer; // layer of the model's texture array
+    TextureType type;
     string path;
 };
 
@@ -37,64 +46,119 @@ public:
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    Material             material;
+    vector<string>       shaderDefines;     // what this mesh has, selects its variant of a ShaderVariants
+    glm::vec3            aabbMin, aabbMax;  // object space bounding box
     unsigned int VAO;
+    unsigned int depthVAO;                  // positions only, tightly packed, for depth-only passes
 
     // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, glm::vec3 diffuseColor = glm::vec3(1.0f))
     {
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
 
+        // pick the layers this mesh samples from
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            if(textures[i].type == TEXTURE_DIFFUSE && material.diffuseLayer < 0)
+                material.diffuseLayer = textures[i].layer;
+            else if(textures[i].type == TEXTURE_SPECULAR && material.specularLayer < 0)
+                material.specularLayer = textures[i].layer;
+        }
+        material.diffuseColor = diffuseColor;
+        if(material.diffuseLayer >= 0)
+            shaderDefines.push_back("HAS_DIFFUSE_MAP");
+        if(material.specularLayer >= 0)
+            shaderDefines.push_back("HAS_SPECULAR_MAP");
+
+        aabbMin = aabbMax = vertices.empty() ? glm::vec3(0.0f) : vertices[0].Position;
+        for(unsigned int i = 1; i < vertices.size(); i++)
+        {
+            aabbMin = glm::min(aabbMin, vertices[i].Position);
+            aabbMax = glm::max(aabbMax, vertices[i].Position);
+        }
+
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
     }
 
-    // render the mesh
+    // render the mesh. Expects the texture array of its model to be bound to the shader's material.textures.
     void Draw(Shader &shader) 
     {
-        // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
-        {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
-             else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
-        }
-        if (textures.size() == 0)
-            glUniform3f(glGetUniformLocation(shader.ID, "kd"), 0.0f, 0.0f, 0.0f);
-        else
-            glUniform3f(glGetUniformLocation(shader.ID, "kd"), 1.0f, 1.0f, 1.0f);
+        setMaterialUniforms(shader);
         
-        // draw mesh
-        glBindVertexArray(VAO);
+        // draw mesh, the VAO stays bound as the next draw rebinds what it needs anyway
+        GLState::bindVertexArray(VAO);
         glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+    }
 
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+    // set this mesh's material in the (bound) shader
+    void setMaterialUniforms(Shader &shader)
+    {
+        const ShaderBinding &binding = getBinding(shader);
+        shader.set(binding.diffuseLayer, material.diffuseLayer);
+        shader.set(binding.specularLayer, material.specularLayer);
+        shader.set(binding.diffuseColor, material.diffuseColor);
+    }
+
+    // the variant specialized to the maps this mesh has, looked up once per ShaderVariants
+    Shader &selectShader(ShaderVariants &variants)
+    {
+        for(unsigned int i = 0; i < variantBindings.size(); i++)
+            if(variantBindings[i].variants == &variants)
+                return *variantBindings[i].shader;
+        VariantBinding binding;
+        binding.variants = &variants;
+        binding.shader = &variants.get(shaderDefines);
+        variantBindings.push_back(binding);
+        return *binding.shader;
     }
 
 private:
     // render data 
     unsigned int VBO, EBO;
+    unsigned int depthVBO;
+
+    // the uniforms of one shader this mesh has been drawn with, resolved on its first draw and again whenever
+    // the shader was rebuilt into a new program, so there is one entry per Shader however often it is reloaded
+    struct ShaderBinding {
+        const Shader *shader;
+        unsigned int program;
+        Uniform<int> diffuseLayer;
+        Uniform<int> specularLayer;
+        Uniform<glm::vec3> diffuseColor;
+    };
+    vector<ShaderBinding> bindings;
+
+    struct VariantBinding {
+        const ShaderVariants *variants;
+        Shader *shader;
+    };
+    vector<VariantBinding> variantBindings;
+
+    const ShaderBinding &getBinding(Shader &shader)
+    {
+        unsigned int i = 0;
+        while(i < bindings.size() && bindings[i].shader != &shader)
+            i++;
+        if(i == bindings.size())
+        {
+            bindings.push_back(ShaderBinding());
+            bindings[i].shader = &shader;
+            bindings[i].program = 0;
+        }
+        ShaderBinding &binding = bindings[i];
+        if(binding.program != shader.ID)
+        {
+            binding.program = shader.ID;
+            binding.diffuseLayer = shader.uniform<int>("material.diffuseLayer");
+            binding.specularLayer = shader.uniform<int>("material.specularLayer");
+            binding.diffuseColor = shader.uniform<glm::vec3>("material.diffuseColor");
+        }
+        return binding;
+    }
 
     // initializes all the buffer objects/arrays
     void setupMesh()
@@ -104,7 +168,7 @@ private:
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
 
-        glBindVertexArray(VAO);
+        GLState::bindVertexArray(VAO);
         // load data into vertex buffers
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         // A great thing about structs is that their memory layout is sequential for all its items.
@@ -132,7 +196,20 @@ private:
         glEnableVertexAttribArray(4);
         glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
 
-        glBindVertexArray(0);
+        // a depth-only pass reads nothing but the positions, packed they are a fifth of the full vertex data
+        vector<glm::vec3> positions(vertices.size());
+        for (unsigned int i = 0; i < vertices.size(); i++)
+            positions[i] = vertices[i].Position;
+        glGenVertexArrays(1, &depthVAO);
+        glGenBuffers(1, &depthVBO);
+        GLState::bindVertexArray(depthVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, depthVBO);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), &positions[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+
+        GLState::bindVertexArray(0);
     }
 };
 #endif
@@ -11,6 +11,7 @@
 #include <assimp/postprocess.h>
 
 #include <learnopengl/mesh.h>
+#include <learnopengl/material.h>
 #include <learnopengl/shader.h>
 
 #include <string>
@@ -21,7 +22,7 @@
 #include <vector>
 using namespace std;
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+inline unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
 class Model 
 {
@@ -29,6 +30,7 @@ public:
     // model data 
     vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
     vector<Mesh>    meshes;
+    TextureArray    textureArray;       // all textures of the model, one layer each, so the whole model draws with a single texture bind
     string directory;
     bool gammaCorrection;
 
@@ -36,16 +38,66 @@ public:
     Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
     {
         loadModel(path);
+        textureArray.build();
     }
 
     // draws the model, and thus all its meshes
     void Draw(Shader &shader)
     {
+        // bind the texture array once, each mesh only selects its layers
+        GLState::polygonMode(GL_FILL);
+        GLState::activeTexture(GL_TEXTURE0);
+        GLState::bindTexture(GL_TEXTURE_2D_ARRAY, textureArray.ID);
+        shader.set(getSamplerBinding(shader), 0);
         for(unsigned int i = 0; i < meshes.size(); i++)
             meshes[i].Draw(shader);
     }
+
+    // draws the model with every mesh using the variant specialized to its material
+    void Draw(ShaderVariants &variants)
+    {
+        GLState::polygonMode(GL_FILL);
+        GLState::activeTexture(GL_TEXTURE0);
+        GLState::bindTexture(GL_TEXTURE_2D_ARRAY, textureArray.ID);
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            Shader &shader = meshes[i].selectShader(variants);
+            shader.use();
+            shader.set(getSamplerBinding(shader), 0);
+            meshes[i].Draw(shader);
+        }
+    }
     
 private:
+    // the material.textures sampler of every shader the model has been drawn with, one entry per Shader that is
+    // updated when it was rebuilt into a new program
+    struct SamplerBinding {
+        const Shader *shader;
+        unsigned int program;
+        Uniform<int> textures;
+    };
+    vector<SamplerBinding> samplerBindings;
+
+    Uniform<int> getSamplerBinding(Shader &shader)
+    {
+        unsigned int i = 0;
+        while(i < samplerBindings.size() && samplerBindings[i].shader != &shader)
+            i++;
+        if(i == samplerBindings.size())
+        {
+            samplerBindings.push_back(SamplerBinding());
+            samplerBindings[i].shader = &shader;
+            samplerBindings[i].program = 0;
+        }
+        SamplerBinding &binding = samplerBindings[i];
+        if(binding.program != shader.ID)
+        {
+            binding.program = shader.ID;
+            binding.textures = shader.uniform<int>("material.textures");
+        }
+        return binding.textures;
+    }
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path)
     {
@@ -144,33 +196,31 @@ private:
         }
         // process materials
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];    
-        // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
-        // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
-        // Same applies to other texture as the following list summarizes:
-        // diffuse: texture_diffuseN
-        // specular: texture_specularN
-        // normal: texture_normalN
+        aiColor3D diffuseColor(1.0f, 1.0f, 1.0f);
+        material->Get(AI_MATKEY_COLOR_DIFFUSE, diffuseColor);
+        // every texture becomes a layer of the model's texture array, tagged with the kind of map it is.
+        // The mesh resolves which layers its shader samples from these tags once, at construction.
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
+        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, TEXTURE_DIFFUSE);
         textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
+        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, TEXTURE_SPECULAR);
         textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
+        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, TEXTURE_NORMAL);
         textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
+        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, TEXTURE_HEIGHT);
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
         
         // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        return Mesh(vertices, indices, textures, glm::vec3(diffuseColor.r, diffuseColor.g, diffuseColor.b));
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
     // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, TextureType textureType)
     {
         vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
@@ -189,10 +239,10 @@ private:
                 }
             }
             if(!skip)
-            {   // if texture hasn't been loaded already, load it
+            {   // if texture hasn't been loaded already, queue it as a new layer of the texture array
                 Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
+                texture.layer = textureArray.addImage(this->directory + '/' + string(str.C_Str()));
+                texture.type = textureType;
                 texture.path = str.C_Str();
                 textures.push_back(texture);
                 textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
@@ -203,7 +253,7 @@ private:
 };
 
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
+inline unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
 {
     string filename = string(path);
     filename = directory + '/' + filename;
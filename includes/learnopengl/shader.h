@@ -4,167 +4,534 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <learnopengl/gl_state.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
 #include <string>
 #include <fstream>
+#include <iterator>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// typed handle to a uniform of a Shader. Resolve it once with Shader::uniform<T>(name), then set it
+// with Shader::set(handle, value) without any string hashing or driver lookups.
+template <typename T>
+struct Uniform
+{
+    int slot = -1;
+};
 
 class Shader
 {
 public:
-    unsigned int ID;
-    // constructor generates the shader on the fly
+    unsigned int ID = 0;
+    // constructor generates the shader on the fly. Every stage is run through preprocess(), so sources can
+    // #include "file" relative to themselves, and each of the defines ("NAME" or "NAME value") is set for all stages.
+    // A deferred shader only hands its sources to the driver and returns; ID stays 0 until finishBuild() checked the
+    // result, so several programs can compile at once and overlap with other startup work.
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr,
+           const std::vector<std::string> &defines = std::vector<std::string>(), bool deferred = false)
+        : vertexPath(vertexPath), fragmentPath(fragmentPath), geometryPath(geometryPath ? geometryPath : ""), defines(defines)
     {
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        try 
-        {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
-            // if geometry shader path is present, also load a geometry shader
-            if(geometryPath != nullptr)
-            {
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
-        }
-        catch (std::ifstream::failure& e)
+        pending = submitBuild();
+        if(!deferred)
+            finishBuild();
+    }
+    // completes a deferred build: waits for the driver if it is not done yet, reports errors and reflects the uniforms
+    // ------------------------------------------------------------------------
+    void finishBuild()
+    {
+        if(ID != 0 || pending.program == 0)
+            return;
+        Build build = pending;
+        pending = Build();
+        finishBuild(build);
+        ID = build.program;
+        reflectUniforms();
+    }
+    bool isBuilt() const
+    {
+        return ID != 0;
+    }
+    // every file the current program was built from, including the ones pulled in with #include
+    // ------------------------------------------------------------------------
+    const std::vector<std::string> &getSourceFiles() const
+    {
+        return sourceFiles;
+    }
+    // starts rebuilding the program from its files, e.g. after they were edited. The current program stays in use
+    // until pollReload() swaps in the new one; a reload that is still pending is dropped.
+    // ------------------------------------------------------------------------
+    void reload()
+    {
+        finishBuild();
+        if(pending.program != 0)
+            discardBuild(pending);
+        pending = submitBuild();
+    }
+    bool isReloading() const
+    {
+        return ID != 0 && pending.program != 0;
+    }
+    // finishes a reload once the driver is done with it. Returns true if the new program linked and replaced the old
+    // one, whose uniform state and block bindings are lost, so they have to be set again. If it failed to build, the
+    // errors are printed and the old program is kept. With GL_KHR_parallel_shader_compile this never blocks,
+    // without it the driver may have to finish compiling here.
+    // ------------------------------------------------------------------------
+    bool pollReload()
+    {
+        if(ID == 0 || pending.program == 0 || !isBuildComplete(pending))
+            return false;
+        Build build = pending;
+        pending = Build();
+        if(!finishBuild(build))
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+            std::cout << "ERROR::SHADER::RELOAD_FAILED: keeping the previous program of " << vertexPath << " / " << fragmentPath << std::endl;
+            discardBuild(build);
+            return false;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if(geometryPath != nullptr)
+        GLState::deleteProgram(ID);
+        ID = build.program;
+        reflectUniforms();
+        return true;
+    }
+    // whether the driver compiles and links on its own threads, so that status queries can be deferred
+    // ------------------------------------------------------------------------
+    static bool parallelCompileSupported()
+    {
+        static int supported = -1;
+        if(supported < 0)
         {
-            const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
+            supported = 0;
+            GLint count = 0;
+            glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+            for(GLint i = 0; i < count; i++)
+            {
+                const char* name = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+                if(name && (std::strcmp(name, "GL_KHR_parallel_shader_compile") == 0 || std::strcmp(name, "GL_ARB_parallel_shader_compile") == 0))
+                    supported = 1;
+            }
         }
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
+        return supported == 1;
+    }
+    // lets the driver use as many compiler threads as it sees fit. The entry point is not part of the glad loader,
+    // so it is looked up with the same function the loader was initialized with, e.g. glfwGetProcAddress.
+    // ------------------------------------------------------------------------
+    static void enableParallelCompile(GLADloadproc load)
+    {
+        if(!parallelCompileSupported())
+            return;
+        typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+        MaxShaderCompilerThreadsProc maxThreads = (MaxShaderCompilerThreadsProc)load("glMaxShaderCompilerThreadsKHR");
+        if(maxThreads == NULL)
+            maxThreads = (MaxShaderCompilerThreadsProc)load("glMaxShaderCompilerThreadsARB");
+        if(maxThreads != NULL)
+            maxThreads(0xFFFFFFFFu);
+    }
+    // directory linked programs are cached in, relative to the working directory. Set it to an empty
+    // string before creating any Shader to always compile from source.
+    // ------------------------------------------------------------------------
+    static std::string& binaryCacheDirectory()
+    {
+        static std::string directory = "shader_cache";
+        return directory;
+    }
+    // reads a shader file and returns the text handed to the compiler: #include "file" lines are replaced by that file,
+    // resolved relative to the including file and pasted only once per stage, and the defines are inserted right after
+    // #version. #line directives keep compiler errors pointing at the right line, the source string number of a
+    // line is the position of its file in the order the files were first included (0 for the file itself).
+    // ------------------------------------------------------------------------
+    static std::string preprocess(const std::string &path, const std::vector<std::string> &defines = std::vector<std::string>(),
+                                  std::vector<std::string> *files = nullptr)
+    {
+        std::vector<std::string> included;
+        std::string code = expandIncludes(path, included);
+        if(files != nullptr)
+            files->insert(files->end(), included.begin(), included.end());
+        if(defines.empty())
+            return code;
 
+        std::string defineLines;
+        for(unsigned int i = 0; i < defines.size(); i++)
+            defineLines += "#define " + defines[i] + "\n";
+        size_t version = code.find("#version");
+        if(version == std::string::npos)
+            return defineLines + "#line 1 0\n" + code;
+        size_t lineEnd = code.find('\n', version);
+        if(lineEnd == std::string::npos)
+            return code + "\n" + defineLines;
+        int nextLine = 2 + (int)std::count(code.begin(), code.begin() + version, '\n');
+        std::ostringstream lineDirective;
+        lineDirective << "#line " << nextLine << " 0\n";
+        return code.substr(0, lineEnd + 1) + defineLines + lineDirective.str() + code.substr(lineEnd + 1);
     }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() 
     { 
-        glUseProgram(ID); 
+        GLState::useProgram(ID); 
+    }
+    // binds a uniform block of this program to a uniform buffer binding point, ignored if the program has no such block
+    // ------------------------------------------------------------------------
+    void bindUniformBlock(const std::string &name, unsigned int binding) const
+    {
+        GLuint index = glGetUniformBlockIndex(ID, name.c_str());
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
+    }
+    // binds a shader storage block of this program to a storage buffer binding point, ignored if the program has no
+    // such block or the context is older than OpenGL 4.3
+    // ------------------------------------------------------------------------
+    void bindStorageBlock(const std::string &name, unsigned int binding) const
+    {
+        if (!GLAD_GL_VERSION_4_3)
+            return;
+        GLuint index = glGetProgramResourceIndex(ID, GL_SHADER_STORAGE_BLOCK, name.c_str());
+        if (index != GL_INVALID_INDEX)
+            glShaderStorageBlockBinding(ID, index, binding);
+    }
+    // returns the location of a uniform from the table reflected at link time, -1 if the program has no such active uniform
+    // ------------------------------------------------------------------------
+    GLint getUniformLocation(const std::string &name) const
+    {
+        std::unordered_map<std::string, GLint>::const_iterator it = uniformLocations.find(name);
+        return it != uniformLocations.end() ? it->second : -1;
+    }
+    // resolves a typed uniform handle, meant to be called once outside of the render loop
+    // ------------------------------------------------------------------------
+    template <typename T>
+    Uniform<T> uniform(const std::string &name)
+    {
+        Uniform<T> handle;
+        for (unsigned int i = 0; i < handleNames.size(); i++)
+        {
+            if (handleNames[i] == name)
+            {
+                handle.slot = (int)i;
+                return handle;
+            }
+        }
+        handle.slot = (int)handleNames.size();
+        handleNames.push_back(name);
+        handleLocations.push_back(getUniformLocation(name));
+        return handle;
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(getUniformLocation(name), (int)value); 
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(getUniformLocation(name), value); 
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(getUniformLocation(name), value); 
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform2fv(getUniformLocation(name), 1, &value[0]); 
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(getUniformLocation(name), x, y); 
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform3fv(getUniformLocation(name), 1, &value[0]); 
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(getUniformLocation(name), x, y, z); 
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform4fv(getUniformLocation(name), 1, &value[0]); 
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) 
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(getUniformLocation(name), x, y, z, w); 
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
+    }
+    // typed handle setters; a handle that was never resolved sets nothing, like location -1 does
+    // ------------------------------------------------------------------------
+    void set(Uniform<bool> u, bool value) const
+    {
+        glUniform1i(locationOf(u.slot), (int)value);
+    }
+    void set(Uniform<int> u, int value) const
+    {
+        glUniform1i(locationOf(u.slot), value);
+    }
+    void set(Uniform<float> u, float value) const
+    {
+        glUniform1f(locationOf(u.slot), value);
+    }
+    void set(Uniform<glm::ivec2> u, const glm::ivec2 &value) const
+    {
+        glUniform2iv(locationOf(u.slot), 1, &value[0]);
+    }
+    void set(Uniform<glm::vec2> u, const glm::vec2 &value) const
+    {
+        glUniform2fv(locationOf(u.slot), 1, &value[0]);
+    }
+    void set(Uniform<glm::vec3> u, const glm::vec3 &value) const
+    {
+        glUniform3fv(locationOf(u.slot), 1, &value[0]);
+    }
+    void set(Uniform<glm::vec4> u, const glm::vec4 &value) const
+    {
+        glUniform4fv(locationOf(u.slot), 1, &value[0]);
+    }
+    void set(Uniform<glm::mat2> u, const glm::mat2 &mat) const
+    {
+        glUniformMatrix2fv(locationOf(u.slot), 1, GL_FALSE, &mat[0][0]);
+    }
+    void set(Uniform<glm::mat3> u, const glm::mat3 &mat) const
+    {
+        glUniformMatrix3fv(locationOf(u.slot), 1, GL_FALSE, &mat[0][0]);
+    }
+    void set(Uniform<glm::mat4> u, const glm::mat4 &mat) const
+    {
+        glUniformMatrix4fv(locationOf(u.slot), 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    std::unordered_map<std::string, GLint> uniformLocations;   // all active uniforms of the linked program
+    std::vector<std::string> handleNames;                      // uniforms resolved as handles, indexed by Uniform::slot
+    std::vector<GLint> handleLocations;
+
+    // location of a handle's uniform, -1 for handles that were never resolved on this shader
+    GLint locationOf(int slot) const
+    {
+        return slot >= 0 && slot < (int)handleLocations.size() ? handleLocations[slot] : -1;
+    }
+
+    // what the program is built from, kept to rebuild it
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::string geometryPath;                                  // empty if there is no geometry stage
+    std::vector<std::string> defines;
+    std::vector<std::string> sourceFiles;
+
+    // a program whose compile and link have been submitted but not checked yet
+    struct Build
+    {
+        GLuint program = 0;
+        GLuint vertex = 0, fragment = 0, geometry = 0;         // 0 when loaded from the binary cache
+        std::string cacheFile;
+        uint64_t sourceHash = 0;                               // of the preprocessed sources and the driver, stored in cacheFile
+        std::vector<std::string> sourceFiles;
+    };
+    Build pending;                                             // a deferred build or reload in flight, program 0 if there is none
+
+    // GL_COMPLETION_STATUS_KHR, glad was generated without the extension
+    static const GLenum COMPLETION_STATUS = 0x91B1;
+
+    // reads and preprocesses the sources and hands them to the driver without waiting for any result
+    // ------------------------------------------------------------------------
+    Build submitBuild()
+    {
+        Build build;
+        // 1. retrieve the vertex/fragment source code from filePath
+        std::string vertexCode = preprocess(vertexPath, defines, &build.sourceFiles);
+        std::string fragmentCode = preprocess(fragmentPath, defines, &build.sourceFiles);
+        std::string geometryCode;
+        if(!geometryPath.empty())
+            geometryCode = preprocess(geometryPath, defines, &build.sourceFiles);
+        // 2. reuse the program linked by an earlier run when the driver still accepts it
+        build.cacheFile = binaryCacheFile();
+        build.sourceHash = binarySourceHash(vertexCode, fragmentCode, geometryCode);
+        if(loadBinary(build.cacheFile, build.sourceHash, build.program))
+            return build;
+        // 3. compile shaders
+        build.vertex = submitStage(GL_VERTEX_SHADER, vertexCode);
+        build.fragment = submitStage(GL_FRAGMENT_SHADER, fragmentCode);
+        if(!geometryPath.empty())
+            build.geometry = submitStage(GL_GEOMETRY_SHADER, geometryCode);
+        // shader Program
+        build.program = glCreateProgram();
+        glAttachShader(build.program, build.vertex);
+        glAttachShader(build.program, build.fragment);
+        if(build.geometry != 0)
+            glAttachShader(build.program, build.geometry);
+        if(!build.cacheFile.empty())
+            glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(build.program);
+        return build;
+    }
+    GLuint submitStage(GLenum type, const std::string &code)
+    {
+        const char* source = code.c_str();
+        GLuint shader = glCreateShader(type);
+        glShaderSource(shader, 1, &source, NULL);
+        glCompileShader(shader);
+        return shader;
+    }
+    bool isBuildComplete(const Build &build) const
+    {
+        if(build.vertex == 0 || !parallelCompileSupported())
+            return true;
+        GLint complete = GL_TRUE;
+        glGetProgramiv(build.program, COMPLETION_STATUS, &complete);
+        return complete != GL_FALSE;
+    }
+    // checks and reports the results of a build, stores a linked program in the binary cache and returns whether it linked
+    // ------------------------------------------------------------------------
+    bool finishBuild(Build &build)
+    {
+        // the files are taken over even if the build failed, so a fix in a newly included file is noticed too
+        sourceFiles = build.sourceFiles;
+        if(build.vertex == 0)
+            return true;    // loadBinary() already checked it
+        checkCompileErrors(build.vertex, "VERTEX");
+        checkCompileErrors(build.fragment, "FRAGMENT");
+        if(build.geometry != 0)
+            checkCompileErrors(build.geometry, "GEOMETRY");
+        bool linked = checkCompileErrors(build.program, "PROGRAM");
+        if(linked)
+            saveBinary(build.program, build.cacheFile, build.sourceHash);
+        // delete the shaders as they're linked into our program now and no longer necessery
+        glDeleteShader(build.vertex);
+        glDeleteShader(build.fragment);
+        if(build.geometry != 0)
+            glDeleteShader(build.geometry);
+        build.vertex = build.fragment = build.geometry = 0;
+        return linked;
+    }
+    void discardBuild(Build &build)
+    {
+        if(build.vertex != 0)
+        {
+            glDeleteShader(build.vertex);
+            glDeleteShader(build.fragment);
+            if(build.geometry != 0)
+                glDeleteShader(build.geometry);
+        }
+        glDeleteProgram(build.program);
+        build = Build();
+    }
+
+    // fills the uniform table from the linked program and re-resolves any handles handed out before
+    // ------------------------------------------------------------------------
+    void reflectUniforms()
+    {
+        uniformLocations.clear();
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(maxLength > 0 ? maxLength : 1);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length;
+            GLint size;
+            GLenum type;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)buffer.size(), &length, &size, &type, &buffer[0]);
+            std::string name(&buffer[0], length);
+            GLint location = glGetUniformLocation(ID, name.c_str());
+            if (location < 0)
+                continue; // member of a uniform block
+            uniformLocations[name] = location;
+            // arrays are reported as "name[0]", also make "name" and every "name[i]" resolvable
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            {
+                std::string base = name.substr(0, name.size() - 3);
+                uniformLocations[base] = location;
+                for (GLint j = 1; j < size; j++)
+                {
+                    std::string element = base + "[" + std::to_string(j) + "]";
+                    uniformLocations[element] = glGetUniformLocation(ID, element.c_str());
+                }
+            }
+        }
+        for (unsigned int i = 0; i < handleNames.size(); i++)
+            handleLocations[i] = getUniformLocation(handleNames[i]);
+    }
+
+    // pastes the file at path with its includes expanded, skipping files that are in included already
+    static std::string expandIncludes(const std::string &path, std::vector<std::string> &included)
+    {
+        int sourceNumber = (int)included.size();
+        included.push_back(path);
+        std::ifstream file(path.c_str());
+        if(!file)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << path << std::endl;
+            return std::string();
+        }
+        size_t slash = path.find_last_of("/\\");
+        std::string directory = slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+
+        std::ostringstream code;
+        std::string line;
+        int lineNumber = 0;
+        while(std::getline(file, line))
+        {
+            lineNumber++;
+            size_t directive = line.find_first_not_of(" \t");
+            if(directive == std::string::npos || line.compare(directive, 8, "#include") != 0)
+            {
+                code << line << "\n";
+                continue;
+            }
+            size_t open = line.find('"', directive + 8);
+            size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+            if(close == std::string::npos)
+            {
+                std::cout << "ERROR::SHADER::MALFORMED_INCLUDE: " << path << ":" << lineNumber << std::endl;
+                code << "\n";
+                continue;
+            }
+            std::string includePath = directory + line.substr(open + 1, close - open - 1);
+            if(std::find(included.begin(), included.end(), includePath) != included.end())
+            {
+                code << "\n";
+                continue;
+            }
+            code << "#line 1 " << included.size() << "\n";
+            code << expandIncludes(includePath, included);
+            code << "#line " << lineNumber + 1 << " " << sourceNumber << "\n";
+        }
+        return code.str();
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    // returns whether the shader compiled or the program linked
+    bool checkCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
         GLchar infoLog[1024];
@@ -186,6 +553,119 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success != 0;
+    }
+
+    // program binary cache
+    // ------------------------------------------------------------------------
+    static bool programBinarySupported()
+    {
+        if(!GLAD_GL_VERSION_4_1)
+            return false;
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+    }
+    // 64-bit FNV-1a, continued from a previous hash
+    static uint64_t hashString(const std::string &text, uint64_t hash = 14695981039346656037ULL)
+    {
+        for(size_t i = 0; i < text.size(); i++)
+        {
+            hash ^= (unsigned char)text[i];
+            hash *= 1099511628211ULL;
+        }
+        // separator, so that moving text between two stages changes the hash
+        hash ^= 0xFF;
+        hash *= 1099511628211ULL;
+        return hash;
+    }
+    // one entry per program, named after its stage paths and defines, so an edited shader overwrites its own entry
+    // instead of adding one. Returns an empty path if caching is off.
+    std::string binaryCacheFile() const
+    {
+        const std::string &directory = binaryCacheDirectory();
+        if(directory.empty() || !programBinarySupported())
+            return std::string();
+        uint64_t hash = hashString(vertexPath);
+        hash = hashString(fragmentPath, hash);
+        hash = hashString(geometryPath, hash);
+        for(unsigned int i = 0; i < defines.size(); i++)
+            hash = hashString(defines[i], hash);
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)hash);
+        return directory + "/" + name;
+    }
+    // what a cached binary must have been built from: the preprocessed sources, defines included, and the driver,
+    // since binaries are only valid for the vendor, renderer and version that produced them
+    static uint64_t binarySourceHash(const std::string &vertexCode, const std::string &fragmentCode, const std::string &geometryCode)
+    {
+        uint64_t hash = hashString(vertexCode);
+        hash = hashString(fragmentCode, hash);
+        hash = hashString(geometryCode, hash);
+        const GLenum driverStrings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+        for(unsigned int i = 0; i < 3; i++)
+        {
+            const char* value = (const char*)glGetString(driverStrings[i]);
+            hash = hashString(value ? value : "", hash);
+        }
+        return hash;
+    }
+    // file layout: the source hash, the GLenum binary format, then the binary. An entry built from other sources
+    // or by another driver is ignored and overwritten after the compile.
+    bool loadBinary(const std::string &file, uint64_t sourceHash, GLuint &program)
+    {
+        if(file.empty())
+            return false;
+        std::ifstream in(file.c_str(), std::ios::binary);
+        if(!in)
+            return false;
+        uint64_t storedHash = 0;
+        GLenum format = 0;
+        in.read((char*)&storedHash, sizeof(storedHash));
+        in.read((char*)&format, sizeof(format));
+        if(!in || storedHash != sourceHash)
+            return false;
+        std::vector<char> binary((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if(binary.empty())
+            return false;
+
+        program = glCreateProgram();
+        glProgramBinary(program, format, &binary[0], (GLsizei)binary.size());
+        GLint success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if(success)
+            return true;
+        // rejected after a driver update or by a different GPU, compile from source and overwrite it
+        glDeleteProgram(program);
+        program = 0;
+        return false;
+    }
+    void saveBinary(GLuint program, const std::string &file, uint64_t sourceHash) const
+    {
+        if(file.empty())
+            return;
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if(length <= 0)
+            return;
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(program, length, NULL, &format, &binary[0]);
+
+#ifdef _WIN32
+        _mkdir(binaryCacheDirectory().c_str());
+#else
+        mkdir(binaryCacheDirectory().c_str(), 0755);
+#endif
+        std::ofstream out(file.c_str(), std::ios::binary);
+        if(!out)
+        {
+            std::cout << "ERROR::SHADER::BINARY_CACHE_NOT_WRITABLE: " << file << std::endl;
+            return;
+        }
+        out.write((const char*)&sourceHash, sizeof(sourceHash));
+        out.write((const char*)&format, sizeof(format));
+        out.write(&binary[0], binary.size());
     }
 };
 #endif
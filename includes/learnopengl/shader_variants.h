@@ -0,0 +1,130 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// the permutations of one shader source: every distinct set of defines is compiled into its own program the first
+// time it is asked for and kept afterwards. Variants are owned here and never move, so Shader pointers to them
+// stay valid for the lifetime of this object.
+class ShaderVariants
+{
+public:
+    // defines are set in every variant, on top of the ones a variant is requested with
+    ShaderVariants(const std::string &vertexPath, const std::string &fragmentPath,
+                   const std::vector<std::string> &defines = std::vector<std::string>())
+        : vertexPath(vertexPath), fragmentPath(fragmentPath), baseDefines(defines), builtCount(0)
+    {
+    }
+
+    // called once for every variant right after it was built, e.g. to bind uniform blocks and set constant uniforms.
+    // Also runs on the variants that already exist.
+    void setInitializer(const std::function<void(Shader&)> &initializer)
+    {
+        this->initializer = initializer;
+        for(VariantMap::iterator it = variants.begin(); it != variants.end(); ++it)
+            if(it->second->isBuilt())
+                initializer(*it->second);
+    }
+
+    const std::function<void(Shader&)> &getInitializer() const
+    {
+        return initializer;
+    }
+
+    // the variant with the given defines, the order of the defines does not matter
+    Shader &get(const std::vector<std::string> &defines)
+    {
+        Shader &variant = find(defines);
+        if(!variant.isBuilt())
+            complete(variant);
+        return variant;
+    }
+
+    // submits the variant for compilation without waiting for it, get() or finishAll() complete it later
+    void request(const std::vector<std::string> &defines)
+    {
+        find(defines);
+    }
+
+    // completes every requested variant
+    void finishAll()
+    {
+        for(VariantMap::iterator it = variants.begin(); it != variants.end(); ++it)
+            if(!it->second->isBuilt())
+                complete(*it->second);
+    }
+
+    // every variant built so far
+    std::vector<Shader*> getVariants() const
+    {
+        std::vector<Shader*> shaders;
+        for(VariantMap::const_iterator it = variants.begin(); it != variants.end(); ++it)
+            if(it->second->isBuilt())
+                shaders.push_back(it->second.get());
+        return shaders;
+    }
+
+    // runs the initializer on a variant again, needed after it was rebuilt
+    void initialize(Shader &variant) const
+    {
+        if(initializer)
+            initializer(variant);
+    }
+
+    unsigned int size() const
+    {
+        return (unsigned int)variants.size();
+    }
+
+    // how many variants have been built, changes whenever getVariants() does
+    unsigned int getBuiltCount() const
+    {
+        return builtCount;
+    }
+
+private:
+    typedef std::map<std::string, std::unique_ptr<Shader> > VariantMap;
+
+    // the variant with the given defines, a new one is only submitted for compilation so that whoever completes
+    // it also runs the initializer on it
+    Shader &find(const std::vector<std::string> &defines)
+    {
+        std::vector<std::string> sorted(defines);
+        std::sort(sorted.begin(), sorted.end());
+        std::string key;
+        for(unsigned int i = 0; i < sorted.size(); i++)
+            key += sorted[i] + "\n";
+
+        VariantMap::iterator it = variants.find(key);
+        if(it != variants.end())
+            return *it->second;
+
+        std::vector<std::string> all(baseDefines);
+        all.insert(all.end(), sorted.begin(), sorted.end());
+        std::unique_ptr<Shader> &variant = variants[key];
+        variant.reset(new Shader(vertexPath.c_str(), fragmentPath.c_str(), nullptr, all, true));
+        return *variant;
+    }
+
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::vector<std::string> baseDefines;
+    std::function<void(Shader&)> initializer;
+    VariantMap variants;
+    unsigned int builtCount;
+
+    void complete(Shader &variant)
+    {
+        variant.finishBuild();
+        builtCount++;
+        initialize(variant);
+    }
+};
+#endif
@@ -0,0 +1,281 @@
+#include "ClusteredLighting.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "Simd.h"
+
+const unsigned int ClusteredLighting::TILES_X;
+const unsigned int ClusteredLighting::TILES_Y;
+const unsigned int ClusteredLighting::SLICES;
+const unsigned int ClusteredLighting::TILES;
+const unsigned int ClusteredLighting::CLUSTERS;
+
+
+ClusteredLighting::ClusteredLighting(unsigned int threads)
+    : minX(CLUSTERS), minY(CLUSTERS), minZ(CLUSTERS), maxX(CLUSTERS), maxY(CLUSTERS), maxZ(CLUSTERS),
+      boundsProjection(0.0f), nearPlane(0.0f), farPlane(0.0f), sliceScale(0.0f), width(1), height(1),
+      lightWords(0), clusters(CLUSTERS), indexCount(0), generation(0), pending(0), quit(false)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::min(std::thread::hardware_concurrency(), 4u));
+    bins.resize(threads);
+    // the calling thread bins too, as thread 0
+    for (unsigned int i = 1; i < threads; i++)
+        workers.push_back(std::thread(&ClusteredLighting::workerLoop, this, i));
+
+    // every cluster empty, for frames whose lists do not fit into the ring
+    GLsizeiptr clustersSize = sizeof(ClusterHeader) + CLUSTERS * sizeof(glm::uvec2);
+    GLint alignment = 256;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    emptyIndicesOffset = (clustersSize + alignment - 1) / alignment * alignment;
+    std::vector<unsigned char> empty(emptyIndicesOffset + sizeof(GLuint), 0);
+    ClusterHeader header;
+    header.counts = glm::uvec4(TILES_X, TILES_Y, SLICES, 0);
+    header.scale = glm::vec4(0.0f);
+    std::memcpy(&empty[0], &header, sizeof(header));
+    glGenBuffers(1, &emptyClusters);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, emptyClusters);
+    glBufferData(GL_COPY_WRITE_BUFFER, empty.size(), &empty[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+ClusteredLighting::~ClusteredLighting() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (unsigned int i = 0; i < workers.size(); i++)
+        workers[i].join();
+    glDeleteBuffers(1, &emptyClusters);
+}
+
+bool ClusteredLighting::isSupported() {
+    return GLAD_GL_VERSION_4_3 != 0;
+}
+
+void ClusteredLighting::bindBlocks(const Shader& shader) {
+    shader.bindStorageBlock("LightClusters", LIGHT_CLUSTERS_BINDING);
+    shader.bindStorageBlock("LightIndices", LIGHT_INDICES_BINDING);
+}
+
+unsigned int ClusteredLighting::sliceOf(float depth) const {
+    if (depth <= nearPlane)
+        return 0;
+    float slice = std::log(depth / nearPlane) * sliceScale;
+    return slice >= (float)(SLICES - 1) ? SLICES - 1 : (unsigned int)slice;
+}
+
+void ClusteredLighting::computeBounds(const glm::mat4& projection) {
+    glm::mat4 inverseProjection = glm::inverse(projection);
+    for (unsigned int slice = 0; slice < SLICES; slice++) {
+        float sliceNear = nearPlane * std::pow(farPlane / nearPlane, (float)slice / SLICES);
+        float sliceFar = nearPlane * std::pow(farPlane / nearPlane, (float)(slice + 1) / SLICES);
+        for (unsigned int y = 0; y < TILES_Y; y++) {
+            for (unsigned int x = 0; x < TILES_X; x++) {
+                glm::vec3 lower(1e30f), upper(-1e30f);
+                // the tile's corners on the near plane, pushed along their view rays to both depths of the slice
+                for (unsigned int corner = 0; corner < 4; corner++) {
+                    float ndcX = -1.0f + 2.0f * (float)(x + (corner & 1)) / TILES_X;
+                    float ndcY = -1.0f + 2.0f * (float)(y + (corner >> 1)) / TILES_Y;
+                    glm::vec4 point = inverseProjection * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+                    glm::vec3 ray = glm::vec3(point) / point.w;
+                    ray /= -ray.z;
+                    lower = glm::min(lower, glm::min(ray * sliceNear, ray * sliceFar));
+                    upper = glm::max(upper, glm::max(ray * sliceNear, ray * sliceFar));
+                }
+                unsigned int cluster = (slice * TILES_Y + y) * TILES_X + x;
+                minX[cluster] = lower.x;
+                minY[cluster] = lower.y;
+                minZ[cluster] = lower.z;
+                maxX[cluster] = upper.x;
+                maxY[cluster] = upper.y;
+                maxZ[cluster] = upper.z;
+            }
+        }
+    }
+    boundsProjection = projection;
+}
+
+void ClusteredLighting::update(const CameraBlock& camera, const std::vector<LightData>& lights, float nearPlane,
+                               float farPlane, int width, int height) {
+    this->width = std::max(width, 1);
+    this->height = std::max(height, 1);
+    if (camera.projection != boundsProjection || nearPlane != this->nearPlane || farPlane != this->farPlane) {
+        this->nearPlane = nearPlane;
+        this->farPlane = farPlane;
+        sliceScale = (float)SLICES / std::log(farPlane / nearPlane);
+        computeBounds(camera.projection);
+    }
+
+    // lights to view space, and the slices each one reaches
+    unsigned int count = (unsigned int)lights.size();
+    this->lights.resize(count);
+    for (unsigned int i = 0; i < count; i++) {
+        const LightData& light = lights[i];
+        glm::vec3 center = glm::vec3(camera.view * glm::vec4(glm::vec3(light.position), 1.0f));
+        BinnedLight& binned = this->lights[i];
+        binned.x = center.x;
+        binned.y = center.y;
+        binned.z = center.z;
+        binned.radiusSquared = light.radius * light.radius;
+        if (light.radius <= 0.0f || -center.z + light.radius < nearPlane || -center.z - light.radius > farPlane) {
+            // reaches no cluster
+            binned.firstSlice = 1;
+            binned.lastSlice = 0;
+            continue;
+        }
+        binned.firstSlice = sliceOf(-center.z - light.radius);
+        binned.lastSlice = sliceOf(-center.z + light.radius);
+    }
+
+    // the bit sets grow with the number of lights, before the workers are woken
+    if ((count + 31) / 32 != lightWords) {
+        lightWords = (count + 31) / 32;
+        for (unsigned int t = 0; t < bins.size(); t++)
+            bins[t].bits.assign(TILES * lightWords, 0);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        generation++;
+        pending = (unsigned int)workers.size();
+    }
+    wake.notify_all();
+    binSlices(0);
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (pending > 0)
+            done.wait(lock);
+    }
+
+    // every bin holds a contiguous run of clusters, so the lists only need their bin's base added
+    indexCount = 0;
+    for (unsigned int t = 0; t < bins.size(); t++) {
+        bins[t].base = indexCount;
+        indexCount += (GLuint)bins[t].indices.size();
+    }
+    for (unsigned int t = 0; t < bins.size(); t++) {
+        unsigned int firstCluster = SLICES * t / (unsigned int)bins.size() * TILES;
+        unsigned int endCluster = SLICES * (t + 1) / (unsigned int)bins.size() * TILES;
+        for (unsigned int c = firstCluster; c < endCluster; c++)
+            clusters[c].x += bins[t].base;
+    }
+}
+
+void ClusteredLighting::binSlices(unsigned int thread) {
+    Bin& bin = bins[thread];
+    bin.indices.clear();
+    unsigned int firstSlice = SLICES * thread / (unsigned int)bins.size();
+    unsigned int endSlice = SLICES * (thread + 1) / (unsigned int)bins.size();
+
+    for (unsigned int slice = firstSlice; slice < endSlice; slice++) {
+        std::fill(bin.bits.begin(), bin.bits.end(), 0u);
+        unsigned int sliceStart = slice * TILES;
+        for (unsigned int l = 0; l < lights.size(); l++) {
+            const BinnedLight& light = lights[l];
+            if (slice < light.firstSlice || slice > light.lastSlice)
+                continue;
+            uint32_t* bits = &bin.bits[l / 32];
+            uint32_t bit = 1u << (l % 32);
+            // distance from the light to each cluster's box, the light reaches the cluster if it is within the radius
+#ifdef SIMD_USE_SSE
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 x = _mm_set1_ps(light.x);
+            const __m128 y = _mm_set1_ps(light.y);
+            const __m128 z = _mm_set1_ps(light.z);
+            const __m128 radiusSquared = _mm_set1_ps(light.radiusSquared);
+            for (unsigned int tile = 0; tile < TILES; tile += 4) {
+                unsigned int c = sliceStart + tile;
+                __m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minX[c]), x), zero), _mm_max_ps(_mm_sub_ps(x, _mm_loadu_ps(&maxX[c])), zero));
+                __m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minY[c]), y), zero), _mm_max_ps(_mm_sub_ps(y, _mm_loadu_ps(&maxY[c])), zero));
+                __m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minZ[c]), z), zero), _mm_max_ps(_mm_sub_ps(z, _mm_loadu_ps(&maxZ[c])), zero));
+                __m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+                int inside = _mm_movemask_ps(_mm_cmple_ps(distanceSquared, radiusSquared));
+                for (unsigned int i = 0; inside != 0; i++, inside >>= 1)
+                    if (inside & 1)
+                        bits[(tile + i) * lightWords] |= bit;
+            }
+#else
+            for (unsigned int tile = 0; tile < TILES; tile++) {
+                unsigned int c = sliceStart + tile;
+                float dx = std::max(minX[c] - light.x, 0.0f) + std::max(light.x - maxX[c], 0.0f);
+                float dy = std::max(minY[c] - light.y, 0.0f) + std::max(light.y - maxY[c], 0.0f);
+                float dz = std::max(minZ[c] - light.z, 0.0f) + std::max(light.z - maxZ[c], 0.0f);
+                if (dx * dx + dy * dy + dz * dz <= light.radiusSquared)
+                    bits[tile * lightWords] |= bit;
+            }
+#endif
+        }
+
+        // the set bits become the clusters' light lists, in light order
+        for (unsigned int tile = 0; tile < TILES; tile++) {
+            glm::uvec2& list = clusters[sliceStart + tile];
+            list.x = (GLuint)bin.indices.size();
+            for (unsigned int word = 0; word < lightWords; word++) {
+                uint32_t bits = bin.bits[tile * lightWords + word];
+                for (unsigned int i = 0; bits != 0; i++, bits >>= 1)
+                    if (bits & 1)
+                        bin.indices.push_back(word * 32 + i);
+            }
+            list.y = (GLuint)bin.indices.size() - list.x;
+        }
+    }
+}
+
+void ClusteredLighting::workerLoop(unsigned int thread) {
+    unsigned int seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!quit && generation == seen)
+                wake.wait(lock);
+            if (quit)
+                return;
+            seen = generation;
+        }
+        binSlices(thread);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--pending == 0)
+                done.notify_one();
+        }
+    }
+}
+
+void ClusteredLighting::upload(RingBuffer& ring) {
+    GLsizeiptr clustersSize = sizeof(ClusterHeader) + CLUSTERS * sizeof(glm::uvec2);
+    // an empty storage range cannot be bound, there is always room for one index
+    GLsizeiptr indicesSize = std::max(indexCount, 1u) * sizeof(GLuint);
+    unsigned char* clusterData;
+    GLuint* indexData;
+    GLintptr clustersOffset = ring.allocate(clustersSize, ring.getStorageAlignment(), (void**)&clusterData);
+    GLintptr indicesOffset = ring.allocate(indicesSize, ring.getStorageAlignment(), (void**)&indexData);
+    if (clustersOffset < 0 || indicesOffset < 0) {
+        // the ring grows for the next frame; until then the shaders see no lights rather than last frame's bindings,
+        // which point into a region that is being rewritten
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, LIGHT_CLUSTERS_BINDING, emptyClusters, 0, clustersSize);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, LIGHT_INDICES_BINDING, emptyClusters, emptyIndicesOffset, sizeof(GLuint));
+        return;
+    }
+
+    ClusterHeader header;
+    header.counts = glm::uvec4(TILES_X, TILES_Y, SLICES, 0);
+    header.scale = glm::vec4((float)TILES_X / width, (float)TILES_Y / height, sliceScale, std::log(nearPlane));
+    std::memcpy(clusterData, &header, sizeof(header));
+    std::memcpy(clusterData + sizeof(header), &clusters[0], CLUSTERS * sizeof(glm::uvec2));
+    for (unsigned int t = 0; t < bins.size(); t++)
+        if (!bins[t].indices.empty())
+            std::memcpy(indexData + bins[t].base, &bins[t].indices[0], bins[t].indices.size() * sizeof(GLuint));
+    ring.flush(clustersOffset, clustersSize);
+    ring.flush(indicesOffset, indicesSize);
+
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, LIGHT_CLUSTERS_BINDING, ring.ID, clustersOffset, clustersSize);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, LIGHT_INDICES_BINDING, ring.ID, indicesOffset, indicesSize);
+}
+
+unsigned int ClusteredLighting::getIndexCount() const {
+    return indexCount;
+}
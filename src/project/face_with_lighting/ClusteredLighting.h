@@ -0,0 +1,110 @@
+#ifndef CLUSTERED_LIGHTING_H
+#define CLUSTERED_LIGHTING_H
+
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+
+#include "RingBuffer.h"
+#include "SceneUniforms.h"
+
+// binding points of the storage buffers read by lighting.glsl with CLUSTERED_LIGHTING, after the indirect renderer's
+const unsigned int LIGHT_CLUSTERS_BINDING = 1;
+const unsigned int LIGHT_INDICES_BINDING = 2;
+
+
+// Clustered forward shading: the view frustum is divided into TILES_X x TILES_Y screen tiles and SLICES depth slices
+// (exponentially spaced, so clusters stay roughly cubic), and every frame each point light is binned on the CPU into
+// the clusters its sphere of LightData::radius touches. The per-cluster light lists go into two storage buffers, and
+// the face shaders shade a fragment with the lights of its cluster only, so hundreds of lights cost little more than
+// the few that reach each pixel while the forward material model stays as it is.
+// The lights are read from the storage buffer SceneUniforms writes with light storage, so their number is not
+// limited by the size of a uniform block.
+// Binning splits the slices over a few worker threads and tests four clusters per SSE instruction where available.
+class ClusteredLighting {
+
+    public:
+        static const unsigned int TILES_X = 16;
+        static const unsigned int TILES_Y = 9;
+        static const unsigned int SLICES = 24;
+
+    public:
+        // threads: how many threads bin lights, the calling one included; 0 picks one per core, up to 4
+        ClusteredLighting(unsigned int threads = 0);
+        ~ClusteredLighting();
+        // whether the current context has storage buffers
+        static bool isSupported();
+        // binds the storage blocks of a program that was compiled with CLUSTERED_LIGHTING
+        static void bindBlocks(const Shader& shader);
+        // bins the lights of the frame; width and height are the size of the framebuffer drawn into
+        void update(const CameraBlock& camera, const std::vector<LightData>& lights, float nearPlane, float farPlane,
+                    int width, int height);
+        // writes the light lists into the ring and binds them
+        void upload(RingBuffer& ring);
+
+        // light list entries of the last update, summed over all clusters
+        unsigned int getIndexCount() const;
+
+    private:
+        // std430 layout of the header of LightClusters in lighting.glsl, followed by one glm::uvec2 per cluster
+        struct ClusterHeader {
+            glm::uvec4 counts;
+            glm::vec4 scale;
+        };
+
+        // a light in view space, with the depth slices its sphere reaches
+        struct BinnedLight {
+            float x, y, z;
+            float radiusSquared;
+            unsigned int firstSlice;
+            unsigned int lastSlice;
+        };
+
+        // what one thread produces for its slices
+        struct Bin {
+            std::vector<uint32_t> bits;         // lightWords for every cluster of the slice being binned
+            std::vector<GLuint> indices;        // the light lists of the thread's clusters, back to back
+            GLuint base;                        // where indices starts in the combined list
+        };
+
+        static const unsigned int TILES = TILES_X * TILES_Y;
+        static const unsigned int CLUSTERS = TILES * SLICES;
+
+        // cluster bounds in view space, structure of arrays in cluster order so four neighbours load at once
+        std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+        glm::mat4 boundsProjection;
+        float nearPlane;
+        float farPlane;
+        float sliceScale;       // slices per unit of log view depth
+        int width;
+        int height;
+
+        std::vector<BinnedLight> lights;
+        unsigned int lightWords;                // words of bits per cluster, one bit per light
+        std::vector<glm::uvec2> clusters;       // offset into the combined list (relative to the bin until merged), count
+        std::vector<Bin> bins;
+        unsigned int indexCount;
+        unsigned int emptyClusters;             // static lists with no lights, bound when the ring is full
+        GLintptr emptyIndicesOffset;
+
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+        unsigned int generation;
+        unsigned int pending;
+        bool quit;
+
+        void computeBounds(const glm::mat4& projection);
+        unsigned int sliceOf(float depth) const;
+        void binSlices(unsigned int thread);
+        void workerLoop(unsigned int thread);
+};
+
+
+#endif
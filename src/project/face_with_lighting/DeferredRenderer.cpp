@@ -0,0 +1,161 @@
+#include "DeferredRenderer.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include <learnopengl/gl_state.h>
+
+
+DeferredRenderer::DeferredRenderer(int width, int height, const SceneUniforms& scene)
+    : lightShader("deferred_light.vs", "deferred_light.fs", nullptr,
+                  std::vector<std::string>(scene.hasLightStorage() ? 1 : 0, "LIGHT_STORAGE")),
+      compositeShader("deferred_composite.vs", "deferred_composite.fs"),
+      scene(scene), width(width), height(height), viewportWidth(width), viewportHeight(height), volume(12, 8)
+{
+    viewportSize = lightShader.uniform<glm::vec2>("viewportSize");
+    glGenVertexArrays(1, &emptyVAO);
+    createTargets();
+    setupShaders();
+}
+
+DeferredRenderer::~DeferredRenderer() {
+    deleteTargets();
+    GLState::deleteVertexArray(emptyVAO);
+}
+
+void DeferredRenderer::setupShaders() {
+    scene.bindBlocks(lightShader);
+    lightShader.use();
+    lightShader.setInt("gAlbedo", UNIT_ALBEDO);
+    lightShader.setInt("gNormal", UNIT_NORMAL);
+    lightShader.setInt("gSpecular", UNIT_SPECULAR);
+    lightShader.setInt("gDepth", UNIT_DEPTH);
+    compositeShader.use();
+    compositeShader.setInt("lightBuffer", UNIT_LIGHT);
+    compositeShader.setInt("gDepth", UNIT_DEPTH);
+}
+
+static unsigned int createTarget(GLenum internalFormat, GLenum format, GLenum type, int width, int height) {
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    GLState::bindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+void DeferredRenderer::createTargets() {
+    GLState::activeTexture(GL_TEXTURE0);
+    albedo = createTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+    normal = createTarget(GL_RGBA16F, GL_RGBA, GL_FLOAT, width, height);
+    specular = createTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+    depth = createTarget(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, width, height);
+    light = createTarget(GL_RGBA16F, GL_RGBA, GL_FLOAT, width, height);
+
+    glGenFramebuffers(1, &gBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedo, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normal, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, specular, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+    const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+    glDrawBuffers(3, drawBuffers);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::DEFERRED_RENDERER::G_BUFFER_INCOMPLETE" << std::endl;
+
+    glGenFramebuffers(1, &lightBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, lightBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, light, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::DEFERRED_RENDERER::LIGHT_BUFFER_INCOMPLETE" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void DeferredRenderer::deleteTargets() {
+    glDeleteFramebuffers(1, &gBuffer);
+    glDeleteFramebuffers(1, &lightBuffer);
+    unsigned int textures[] = { albedo, normal, specular, depth, light };
+    glDeleteTextures(5, textures);
+    // the names may be reused by the next textures, GLState must not think they are still bound
+    GLState::invalidate();
+}
+
+void DeferredRenderer::resize(int width, int height) {
+    if (width == this->width && height == this->height)
+        return;
+    if (width <= 0 || height <= 0)
+        return;     // minimized
+    this->width = width;
+    this->height = height;
+    deleteTargets();
+    createTargets();
+}
+
+void DeferredRenderer::beginGeometryPass(int viewportWidth, int viewportHeight) {
+    this->viewportWidth = std::min(viewportWidth, width);
+    this->viewportHeight = std::min(viewportHeight, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+    glViewport(0, 0, this->viewportWidth, this->viewportHeight);
+    const GLfloat zero[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 3; i++)
+        glClearBufferfv(GL_COLOR, i, zero);
+    const GLfloat one = 1.0f;
+    glClearBufferfv(GL_DEPTH, 0, &one);
+}
+
+void DeferredRenderer::bindTextures() {
+    GLState::activeTexture(GL_TEXTURE0 + UNIT_ALBEDO);
+    GLState::bindTexture(GL_TEXTURE_2D, albedo);
+    GLState::activeTexture(GL_TEXTURE0 + UNIT_NORMAL);
+    GLState::bindTexture(GL_TEXTURE_2D, normal);
+    GLState::activeTexture(GL_TEXTURE0 + UNIT_SPECULAR);
+    GLState::bindTexture(GL_TEXTURE_2D, specular);
+    GLState::activeTexture(GL_TEXTURE0 + UNIT_DEPTH);
+    GLState::bindTexture(GL_TEXTURE_2D, depth);
+    GLState::activeTexture(GL_TEXTURE0 + UNIT_LIGHT);
+    GLState::bindTexture(GL_TEXTURE_2D, light);
+}
+
+void DeferredRenderer::shadeLights(int lightCount, GLuint target) {
+    bindTextures();
+
+    // light volumes: only the back faces, so a volume still shades when the camera is inside it, and without depth
+    // test, since the depth of the scene is read as a texture here. Depth clamping keeps the back faces of volumes
+    // larger than the far plane from being clipped away.
+    glBindFramebuffer(GL_FRAMEBUFFER, lightBuffer);
+    const GLfloat zero[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    glClearBufferfv(GL_COLOR, 0, zero);
+    glDisable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+    glEnable(GL_DEPTH_CLAMP);
+    glEnable(GL_CULL_FACE);
+    glCullFace(GL_FRONT);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+
+    glViewport(0, 0, viewportWidth, viewportHeight);
+    lightShader.use();
+    lightShader.set(viewportSize, glm::vec2((float)viewportWidth, (float)viewportHeight));
+    GLState::polygonMode(GL_FILL);
+    GLState::bindVertexArray(volume.VAO);
+    glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)volume.Indices.size(), GL_UNSIGNED_INT, 0, lightCount);
+
+    glDisable(GL_BLEND);
+    glDisable(GL_DEPTH_CLAMP);
+    glCullFace(GL_BACK);
+    glDisable(GL_CULL_FACE);
+
+    // composite: lit pixels and their depth go to the target, the background keeps what it was cleared to. All the
+    // targets share the corner the frame is drawn in, so every pass reads the texel at its own fragment
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_ALWAYS);
+    compositeShader.use();
+    GLState::bindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glDepthFunc(GL_LESS);
+}
@@ -0,0 +1,75 @@
+#ifndef DEFERRED_RENDERER_H
+#define DEFERRED_RENDERER_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/shader.h>
+
+#include "SceneUniforms.h"
+#include "Sphere.h"
+
+
+// Deferred shading for scenes with many point lights. The geometry pass writes the surface attributes of every
+// opaque draw into a G-buffer (albedo, normal and shininess, specular color, depth). The lighting pass then draws one
+// sphere per light, sized by LightData::radius, and shades only the pixels it covers from the G-buffer, adding the
+// result up in a floating point light buffer. So lighting costs grow with the lit pixels instead of with meshes times
+// lights. A final pass copies the light buffer and the depth into the target framebuffer, so forward draws (the
+// wireframe light sphere) can follow as usual.
+// The targets are allocated at the window size; a frame can be drawn into a smaller lower left corner of them (dynamic
+// resolution), which changes nothing but the viewport.
+class DeferredRenderer {
+
+    public:
+        // texture units the lighting and composite passes read the G-buffer from
+        enum Unit {
+            UNIT_ALBEDO = 0,
+            UNIT_NORMAL,
+            UNIT_SPECULAR,
+            UNIT_DEPTH,
+            UNIT_LIGHT
+        };
+
+        Shader lightShader;         // light volumes
+        Shader compositeShader;     // light buffer and depth to the target framebuffer
+
+    public:
+        DeferredRenderer(int width, int height, const SceneUniforms& scene);
+        ~DeferredRenderer();
+        // reallocates the targets if the window's framebuffer size changed
+        void resize(int width, int height);
+        // binds and clears the G-buffer and sets the viewport to its lower left viewportWidth x viewportHeight
+        // pixels, the opaque draws of the frame go in after it
+        void beginGeometryPass(int viewportWidth, int viewportHeight);
+        // accumulates the first lightCount lights of the Lights block and writes the lit image and its depth into
+        // the same corner of the target framebuffer. Background pixels are left as they are.
+        void shadeLights(int lightCount, GLuint target = 0);
+        // restores sampler units and block bindings, after the shaders were rebuilt
+        void setupShaders();
+
+    private:
+        const SceneUniforms& scene;
+        int width;
+        int height;
+        int viewportWidth;
+        int viewportHeight;
+        Uniform<glm::vec2> viewportSize;
+
+        unsigned int gBuffer;
+        unsigned int albedo;
+        unsigned int normal;
+        unsigned int specular;
+        unsigned int depth;
+
+        unsigned int lightBuffer;   // framebuffer of the accumulation texture only, so the G-buffer is never written while it is read
+        unsigned int light;
+
+        Sphere volume;
+        unsigned int emptyVAO;      // for the attribute-less fullscreen triangle
+
+        void createTargets();
+        void deleteTargets();
+        void bindTextures();
+};
+
+
+#endif
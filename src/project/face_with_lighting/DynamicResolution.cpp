@@ -0,0 +1,170 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include <learnopengl/gl_state.h>
+
+// the scale moves in steps of this, and at most by these factors per measurement: down quickly to catch a
+// missed target, up slowly so that it does not overshoot again right away
+const float SCALE_STEP = 1.0f / 32.0f;
+const float MAX_SCALE_DROP = 0.85f;
+const float MAX_SCALE_RISE = 1.05f;
+// the scale is aimed at this share of the target, leaving headroom for frames that take longer than the average
+const float TARGET_HEADROOM = 0.9f;
+// how strongly the upscale sharpens at half resolution, it fades out towards full resolution
+const float SHARPNESS = 0.15f;
+
+
+DynamicResolution::DynamicResolution(float targetMilliseconds, float minScale)
+    : upscaleShader("deferred_composite.vs", "upscale.fs"),
+      targetTime(targetMilliseconds), minScale(std::min(std::max(minScale, 0.1f), 1.0f)), scale(1.0f), gpuTime(0.0f),
+      windowWidth(0), windowHeight(0), width(0), height(0), FBO(0), color(0), depth(0), queryFrame(0)
+{
+    glGenVertexArrays(1, &emptyVAO);
+    glGenQueries(QUERY_FRAMES, queries);
+    for (unsigned int i = 0; i < QUERY_FRAMES; i++)
+        queryPending[i] = false;
+    setupShader();
+}
+
+DynamicResolution::~DynamicResolution() {
+    deleteTarget();
+    glDeleteQueries(QUERY_FRAMES, queries);
+    GLState::deleteVertexArray(emptyVAO);
+}
+
+void DynamicResolution::setupShader() {
+    upscaleShader.use();
+    upscaleShader.setInt("scene", 0);
+    upscaleScale = upscaleShader.uniform<glm::vec2>("scale");
+    upscaleWindowSize = upscaleShader.uniform<glm::vec2>("windowSize");
+    upscaleSharpness = upscaleShader.uniform<float>("sharpness");
+}
+
+void DynamicResolution::createTarget() {
+    GLState::activeTexture(GL_TEXTURE0);
+    glGenTextures(1, &color);
+    GLState::bindTexture(GL_TEXTURE_2D, color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, windowWidth, windowHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glGenTextures(1, &depth);
+    GLState::bindTexture(GL_TEXTURE_2D, depth);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, windowWidth, windowHeight, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenFramebuffers(1, &FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::DYNAMIC_RESOLUTION::FRAMEBUFFER_INCOMPLETE" << std::endl;
+}
+
+void DynamicResolution::deleteTarget() {
+    if (FBO == 0)
+        return;
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteTextures(1, &color);
+    glDeleteTextures(1, &depth);
+    FBO = color = depth = 0;
+    // the names may be reused by the next textures, GLState must not think they are still bound
+    GLState::invalidate();
+}
+
+void DynamicResolution::begin(int width, int height) {
+    if (width > 0 && height > 0 && (width != windowWidth || height != windowHeight)) {
+        windowWidth = width;
+        windowHeight = height;
+        deleteTarget();
+        createTarget();
+    }
+    update();
+
+    this->width = std::max(1, (int)(windowWidth * scale + 0.5f));
+    this->height = std::max(1, (int)(windowHeight * scale + 0.5f));
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glViewport(0, 0, this->width, this->height);
+
+    glBeginQuery(GL_TIME_ELAPSED, queries[queryFrame]);
+}
+
+void DynamicResolution::end() {
+    glEndQuery(GL_TIME_ELAPSED);
+    queryPending[queryFrame] = true;
+    queryScale[queryFrame] = scale;
+    queryFrame = (queryFrame + 1) % QUERY_FRAMES;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, windowWidth, windowHeight);
+    glDisable(GL_DEPTH_TEST);
+    upscaleShader.use();
+    upscaleShader.set(upscaleScale, glm::vec2((float)width / windowWidth, (float)height / windowHeight));
+    upscaleShader.set(upscaleWindowSize, glm::vec2((float)windowWidth, (float)windowHeight));
+    upscaleShader.set(upscaleSharpness, SHARPNESS * (1.0f - scale) * 2.0f);
+    GLState::activeTexture(GL_TEXTURE0);
+    GLState::bindTexture(GL_TEXTURE_2D, color);
+    GLState::polygonMode(GL_FILL);
+    GLState::bindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glEnable(GL_DEPTH_TEST);
+}
+
+void DynamicResolution::update() {
+    // the newest finished measurement, without waiting for the GPU; queries of the oldest frame first. Frames
+    // drawn before the last change of scale still say how long the old scale took, they do not move it again.
+    bool measured = false;
+    for (unsigned int age = 0; age < QUERY_FRAMES; age++) {
+        unsigned int frame = (queryFrame + age) % QUERY_FRAMES;
+        if (!queryPending[frame])
+            continue;
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(queries[frame], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(queries[frame], GL_QUERY_RESULT, &elapsed);
+        queryPending[frame] = false;
+        gpuTime = (float)elapsed / 1.0e6f;
+        measured = queryScale[frame] == scale;
+    }
+    if (!measured || gpuTime <= 0.0f)
+        return;
+
+    float desired = scale * std::sqrt(targetTime * TARGET_HEADROOM / gpuTime);
+    // only whole steps count, a change smaller than one keeps the scale where it is
+    float stepped = std::floor(desired / SCALE_STEP + 0.5f) * SCALE_STEP;
+    // the factors limit the steps taken at once (highest and lowest count steps), but one step is always allowed:
+    // at small scales the factors are less than a step, and the scale could otherwise never move again
+    float highest = std::max(std::floor(scale * MAX_SCALE_RISE / SCALE_STEP), std::floor(scale / SCALE_STEP) + 1.0f);
+    float lowest = std::min(std::ceil(scale * MAX_SCALE_DROP / SCALE_STEP), std::ceil(scale / SCALE_STEP) - 1.0f);
+    stepped = std::min(std::max(stepped, lowest * SCALE_STEP), highest * SCALE_STEP);
+    stepped = std::min(std::max(stepped, minScale), 1.0f);
+    if (std::fabs(stepped - scale) >= SCALE_STEP * 0.5f)
+        scale = stepped;
+}
+
+GLuint DynamicResolution::getFramebuffer() const {
+    return FBO;
+}
+
+int DynamicResolution::getWidth() const {
+    return width;
+}
+
+int DynamicResolution::getHeight() const {
+    return height;
+}
+
+float DynamicResolution::getScale() const {
+    return scale;
+}
+
+float DynamicResolution::getGpuTime() const {
+    return gpuTime;
+}
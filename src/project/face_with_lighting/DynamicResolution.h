@@ -0,0 +1,74 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/shader.h>
+
+
+// Renders the scene into an offscreen target at a fraction of the window's resolution and scales it up to the
+// window with a sharpening filter. The fraction follows the GPU: the time between begin() and end() is measured
+// with GL_TIME_ELAPSED queries, and when it is over the target the scale goes down, when there is room it goes back
+// up, between the minimum scale and 1. Pixel cost grows with the area, so each step moves the scale by the square
+// root of the ratio of target to measured time, in steps of 1/32 so that small jitter does not change it.
+// The target is allocated at the window size and the scene drawn into its lower left corner, so changing the scale
+// reallocates nothing.
+class DynamicResolution {
+
+    public:
+        Shader upscaleShader;
+
+    public:
+        // targetMilliseconds: the GPU time per frame to stay under
+        DynamicResolution(float targetMilliseconds, float minScale = 0.5f);
+        ~DynamicResolution();
+        // binds the target, sets the viewport to the scaled size and starts timing; width and height are the
+        // window's framebuffer size
+        void begin(int width, int height);
+        // stops timing and draws the target into the default framebuffer at the window size
+        void end();
+        // restores sampler units and uniform handles, after the shader was rebuilt
+        void setupShader();
+
+        // framebuffer the scene is drawn into between begin() and end()
+        GLuint getFramebuffer() const;
+        // the scaled size of this frame
+        int getWidth() const;
+        int getHeight() const;
+        float getScale() const;
+        // the latest GPU time measured, in milliseconds
+        float getGpuTime() const;
+
+    private:
+        static const unsigned int QUERY_FRAMES = 4;
+
+        float targetTime;
+        float minScale;
+        float scale;
+        float gpuTime;
+        int windowWidth;
+        int windowHeight;
+        int width;
+        int height;
+
+        unsigned int FBO;
+        unsigned int color;
+        unsigned int depth;
+        unsigned int emptyVAO;
+        Uniform<glm::vec2> upscaleScale;
+        Uniform<glm::vec2> upscaleWindowSize;
+        Uniform<float> upscaleSharpness;
+
+        unsigned int queries[QUERY_FRAMES];
+        bool queryPending[QUERY_FRAMES];
+        float queryScale[QUERY_FRAMES];     // the scale the frame of each query was drawn at
+        unsigned int queryFrame;
+
+        void createTarget();
+        void deleteTarget();
+        // reads finished timer queries and adjusts the scale
+        void update();
+};
+
+
+#endif
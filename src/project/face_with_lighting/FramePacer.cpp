@@ -0,0 +1,68 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <thread>
+
+// bounds of the spin margin; it starts at the lower one and grows while sleeps wake up later than that
+const std::chrono::microseconds MIN_SPIN_MARGIN(500);
+const std::chrono::microseconds MAX_SPIN_MARGIN(4000);
+
+
+FramePacer::FramePacer(double targetFps)
+    : period(Clock::duration::zero()), spinMargin(MIN_SPIN_MARGIN), started(false), next(0)
+{
+    if (targetFps > 0.0)
+        period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetFps));
+    frameTimes.reserve(HISTORY);
+}
+
+void FramePacer::wait() {
+    if (period == Clock::duration::zero())
+        return;
+    Clock::time_point now = Clock::now();
+    // frames are due on a fixed cadence, so one late frame does not push back all that follow; after a long
+    // stall (a breakpoint, a dragged window) the cadence starts over instead of rushing to catch up
+    deadline += period;
+    if (deadline < now - period || deadline > now + period)
+        deadline = now;
+
+    Clock::time_point wakeUp = deadline - spinMargin;
+    if (now < wakeUp) {
+        std::this_thread::sleep_for(wakeUp - now);
+        Clock::duration late = Clock::now() - wakeUp;
+        // leave more to the spin after a late wake up, give it back slowly while sleeps are punctual
+        if (late > spinMargin)
+            spinMargin = std::min<Clock::duration>(late + late / 4, MAX_SPIN_MARGIN);
+        else
+            spinMargin = std::max<Clock::duration>(spinMargin - spinMargin / 64, MIN_SPIN_MARGIN);
+    }
+    while (Clock::now() < deadline)
+        std::this_thread::yield();
+}
+
+void FramePacer::beginFrame() {
+    Clock::time_point now = Clock::now();
+    if (started) {
+        float milliseconds = std::chrono::duration<float, std::milli>(now - lastFrame).count();
+        if (frameTimes.size() < HISTORY)
+            frameTimes.push_back(milliseconds);
+        else
+            frameTimes[next] = milliseconds;
+        next = (next + 1) % HISTORY;
+    }
+    lastFrame = now;
+    started = true;
+}
+
+double FramePacer::getPercentile(double fraction) const {
+    if (frameTimes.empty())
+        return 0.0;
+    std::vector<float> sorted(frameTimes);
+    unsigned int index = (unsigned int)(fraction * (sorted.size() - 1) + 0.5);
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+    return sorted[index];
+}
+
+unsigned int FramePacer::getFrameCount() const {
+    return (unsigned int)frameTimes.size();
+}
@@ -0,0 +1,45 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <chrono>
+#include <vector>
+
+
+// Frame limiter and frame time statistics. wait() holds the render loop back until the next frame is due at the
+// target rate: it sleeps for most of the remaining time and spins through the last stretch, because sleeps can
+// wake up late by a millisecond or more. How much to leave for spinning is learned from how late the sleeps wake
+// up, so the CPU idles for most of every frame while frames still start on time.
+// The time between consecutive beginFrame() calls is recorded over the last HISTORY frames for percentiles.
+class FramePacer {
+
+    public:
+        static const unsigned int HISTORY = 4096;
+
+    public:
+        // targetFps 0 leaves the rate to the swap interval
+        FramePacer(double targetFps = 0.0);
+        // blocks until the next frame is due
+        void wait();
+        // marks the start of a frame
+        void beginFrame();
+
+        // the frame time in milliseconds that the given fraction of the recorded frames (0 to 1) took at most
+        double getPercentile(double fraction) const;
+        // frames recorded, up to HISTORY
+        unsigned int getFrameCount() const;
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        Clock::duration period;
+        Clock::time_point deadline;     // when the next frame is due
+        Clock::duration spinMargin;     // left to spinning at the end of each wait
+        Clock::time_point lastFrame;
+        bool started;
+
+        std::vector<float> frameTimes;  // ring of milliseconds
+        unsigned int next;
+};
+
+
+#endif
@@ -0,0 +1,174 @@
+#include "FrustumCuller.h"
+
+#include <cmath>
+
+#include "Simd.h"
+
+const unsigned int FrustumCuller::BATCH;
+
+
+unsigned int FrustumCuller::Volumes::add() {
+    unsigned int index = count++;
+    if (count > x.size()) {
+        // a whole batch more; the padding lanes are tested along and ignored
+        size_t size = x.size() + BATCH;
+        x.resize(size, 0.0f);
+        y.resize(size, 0.0f);
+        z.resize(size, 0.0f);
+        extentX.resize(size, 0.0f);
+        extentY.resize(size, 0.0f);
+        extentZ.resize(size, 0.0f);
+        visible.resize(size, 0);
+    }
+    return index;
+}
+
+void FrustumCuller::Volumes::clear() {
+    count = 0;
+    x.clear();
+    y.clear();
+    z.clear();
+    extentX.clear();
+    extentY.clear();
+    extentZ.clear();
+    visible.clear();
+}
+
+FrustumCuller::FrustumCuller() : visibleBoxes(0)
+{
+}
+
+unsigned int FrustumCuller::addBox(const glm::vec3& aabbMin, const glm::vec3& aabbMax, const glm::mat4& model) {
+    unsigned int box = boxes.add();
+    setBox(box, aabbMin, aabbMax, model);
+    boxes.visible[box] = 1;
+    return box;
+}
+
+void FrustumCuller::setBox(unsigned int box, const glm::vec3& aabbMin, const glm::vec3& aabbMax, const glm::mat4& model) {
+    // the center moves with the model, the extent of the enclosing box is the extent along each rotated and
+    // scaled axis, summed
+    glm::vec3 center = glm::vec3(model * glm::vec4((aabbMin + aabbMax) * 0.5f, 1.0f));
+    glm::mat3 axes(model);
+    glm::vec3 halfSize = (aabbMax - aabbMin) * 0.5f;
+    glm::vec3 extent = glm::abs(axes[0]) * halfSize.x + glm::abs(axes[1]) * halfSize.y + glm::abs(axes[2]) * halfSize.z;
+    boxes.x[box] = center.x;
+    boxes.y[box] = center.y;
+    boxes.z[box] = center.z;
+    boxes.extentX[box] = extent.x;
+    boxes.extentY[box] = extent.y;
+    boxes.extentZ[box] = extent.z;
+}
+
+unsigned int FrustumCuller::addSphere(const glm::vec3& center, float radius) {
+    unsigned int sphere = spheres.add();
+    setSphere(sphere, center, radius);
+    spheres.visible[sphere] = 1;
+    return sphere;
+}
+
+void FrustumCuller::setSphere(unsigned int sphere, const glm::vec3& center, float radius) {
+    spheres.x[sphere] = center.x;
+    spheres.y[sphere] = center.y;
+    spheres.z[sphere] = center.z;
+    spheres.extentX[sphere] = radius;
+}
+
+void FrustumCuller::clear() {
+    boxes.clear();
+    spheres.clear();
+    visibleBoxes = 0;
+}
+
+void FrustumCuller::cull(const glm::vec4 planes[6]) {
+    cullVolumes(boxes, planes, false);
+    cullVolumes(spheres, planes, true);
+    visibleBoxes = 0;
+    for (unsigned int i = 0; i < boxes.count; i++)
+        visibleBoxes += boxes.visible[i];
+}
+
+void FrustumCuller::cullVolumes(Volumes& volumes, const glm::vec4 planes[6], bool spheres) {
+    // a volume is outside when, for some plane, the signed distance of its center is below minus its radius
+    // along the plane's normal: the sphere's radius, or the box's half extents projected onto the normal
+    const unsigned int size = (unsigned int)volumes.x.size();
+#if defined(SIMD_USE_AVX)
+    const __m256 zero = _mm256_setzero_ps();
+    for (unsigned int i = 0; i < size; i += 8) {
+        __m256 x = _mm256_loadu_ps(&volumes.x[i]);
+        __m256 y = _mm256_loadu_ps(&volumes.y[i]);
+        __m256 z = _mm256_loadu_ps(&volumes.z[i]);
+        __m256 extentX = _mm256_loadu_ps(&volumes.extentX[i]);
+        __m256 extentY = _mm256_loadu_ps(&volumes.extentY[i]);
+        __m256 extentZ = _mm256_loadu_ps(&volumes.extentZ[i]);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            const glm::vec4& plane = planes[p];
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), x), _mm256_mul_ps(_mm256_set1_ps(plane.y), y)),
+                                            _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.z), z), _mm256_set1_ps(plane.w)));
+            __m256 radius = spheres ? extentX
+                : _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(std::fabs(plane.x)), extentX), _mm256_mul_ps(_mm256_set1_ps(std::fabs(plane.y)), extentY)),
+                                _mm256_mul_ps(_mm256_set1_ps(std::fabs(plane.z)), extentZ));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_GE_OQ));
+        }
+        int mask = _mm256_movemask_ps(inside);
+        for (unsigned int lane = 0; lane < 8; lane++)
+            volumes.visible[i + lane] = (unsigned char)((mask >> lane) & 1);
+    }
+#elif defined(SIMD_USE_SSE)
+    const __m128 zero = _mm_setzero_ps();
+    for (unsigned int i = 0; i < size; i += 4) {
+        __m128 x = _mm_loadu_ps(&volumes.x[i]);
+        __m128 y = _mm_loadu_ps(&volumes.y[i]);
+        __m128 z = _mm_loadu_ps(&volumes.z[i]);
+        __m128 extentX = _mm_loadu_ps(&volumes.extentX[i]);
+        __m128 extentY = _mm_loadu_ps(&volumes.extentY[i]);
+        __m128 extentZ = _mm_loadu_ps(&volumes.extentZ[i]);
+        __m128 inside = _mm_cmpeq_ps(zero, zero);
+        for (int p = 0; p < 6; p++) {
+            const glm::vec4& plane = planes[p];
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), x), _mm_mul_ps(_mm_set1_ps(plane.y), y)),
+                                         _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), z), _mm_set1_ps(plane.w)));
+            __m128 radius = spheres ? extentX
+                : _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::fabs(plane.x)), extentX), _mm_mul_ps(_mm_set1_ps(std::fabs(plane.y)), extentY)),
+                             _mm_mul_ps(_mm_set1_ps(std::fabs(plane.z)), extentZ));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+        }
+        int mask = _mm_movemask_ps(inside);
+        for (unsigned int lane = 0; lane < 4; lane++)
+            volumes.visible[i + lane] = (unsigned char)((mask >> lane) & 1);
+    }
+#else
+    for (unsigned int i = 0; i < size; i++) {
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; p++) {
+            const glm::vec4& plane = planes[p];
+            float distance = plane.x * volumes.x[i] + plane.y * volumes.y[i] + plane.z * volumes.z[i] + plane.w;
+            float radius = spheres ? volumes.extentX[i]
+                : std::fabs(plane.x) * volumes.extentX[i] + std::fabs(plane.y) * volumes.extentY[i] + std::fabs(plane.z) * volumes.extentZ[i];
+            inside = distance + radius >= 0.0f;
+        }
+        volumes.visible[i] = inside ? 1 : 0;
+    }
+#endif
+}
+
+bool FrustumCuller::isBoxVisible(unsigned int box) const {
+    return boxes.visible[box] != 0;
+}
+
+bool FrustumCuller::isSphereVisible(unsigned int sphere) const {
+    return spheres.visible[sphere] != 0;
+}
+
+const unsigned char* FrustumCuller::getBoxVisibility() const {
+    return boxes.visible.empty() ? NULL : &boxes.visible[0];
+}
+
+unsigned int FrustumCuller::getBoxCount() const {
+    return boxes.count;
+}
+
+unsigned int FrustumCuller::getVisibleBoxCount() const {
+    return visibleBoxes;
+}
@@ -0,0 +1,63 @@
+#ifndef FRUSTUM_CULLER_H
+#define FRUSTUM_CULLER_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+
+// Tests bounding boxes and spheres against the planes of the view frustum (Camera::ExtractFrustumPlanes), many at
+// once. Both are kept structure-of-arrays: one array per coordinate, so a single instruction tests the same plane
+// against 8 volumes with AVX, 4 with SSE, or one at a time where neither is available. A box is stored as its center
+// and half extents in world space; it is outside when it lies entirely behind one of the planes. That keeps some
+// boxes near the corners of the frustum that are in fact outside, never the other way round.
+// Volumes are added once and moved with setBox() and setSphere(); cull() tests all of them and the results are read
+// per index, or as one byte per box for RenderQueue.
+class FrustumCuller {
+
+    public:
+        FrustumCuller();
+        // adds the world space box enclosing the object space box from aabbMin to aabbMax placed with model,
+        // returns its index
+        unsigned int addBox(const glm::vec3& aabbMin, const glm::vec3& aabbMax, const glm::mat4& model);
+        void setBox(unsigned int box, const glm::vec3& aabbMin, const glm::vec3& aabbMax, const glm::mat4& model);
+        // adds a sphere in world space, returns its index
+        unsigned int addSphere(const glm::vec3& center, float radius);
+        void setSphere(unsigned int sphere, const glm::vec3& center, float radius);
+        void clear();
+
+        // tests every box and sphere against the six planes
+        void cull(const glm::vec4 planes[6]);
+
+        // results of the last cull()
+        bool isBoxVisible(unsigned int box) const;
+        bool isSphereVisible(unsigned int sphere) const;
+        // 1 for each box in view, 0 for the others, in the order they were added
+        const unsigned char* getBoxVisibility() const;
+        unsigned int getBoxCount() const;
+        unsigned int getVisibleBoxCount() const;
+
+    private:
+        // the arrays are padded to a whole number of batches. The padding lanes, empty volumes at the origin, are
+        // tested along with the rest so the loops need no remainder, but their results are past count and never read
+        static const unsigned int BATCH = 8;
+
+        struct Volumes {
+            unsigned int count;
+            std::vector<float> x, y, z;                      // centers
+            std::vector<float> extentX, extentY, extentZ;    // half extents of boxes, the radius in extentX for spheres
+            std::vector<unsigned char> visible;
+
+            Volumes() : count(0) {}
+            unsigned int add();
+            void clear();
+        };
+
+        Volumes boxes;
+        Volumes spheres;
+        unsigned int visibleBoxes;
+
+        static void cullVolumes(Volumes& volumes, const glm::vec4 planes[6], bool spheres);
+};
+
+
+#endif
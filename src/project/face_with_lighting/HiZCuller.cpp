@@ -0,0 +1,282 @@
+#include "HiZCuller.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include <learnopengl/gl_state.h>
+
+#include "Simd.h"
+
+const int HiZCuller::BLOCK;
+const unsigned int HiZCuller::READBACKS;
+
+// a corner this close to the plane of the camera, or behind it, makes the box count as visible: its projection
+// would not be bounded
+const float MIN_CLIP_W = 1.0e-5f;
+
+
+HiZCuller::HiZCuller()
+    : reduceShader("deferred_composite.vs", "hiz_reduce.fs"),
+      depthCopy(0), reduced(0), reduceFBO(0), copyWidth(0), copyHeight(0), nextReadback(0),
+      sourceWidth(0), sourceHeight(0), viewProjection(1.0f)
+{
+    sourceSize = reduceShader.uniform<glm::ivec2>("sourceSize");
+    glGenVertexArrays(1, &emptyVAO);
+    for (unsigned int i = 0; i < READBACKS; i++) {
+        glGenBuffers(1, &readbacks[i].PBO);
+        readbacks[i].fence = 0;
+        readbacks[i].width = readbacks[i].height = 0;
+        readbacks[i].sourceWidth = readbacks[i].sourceHeight = 0;
+    }
+    setupShader();
+}
+
+HiZCuller::~HiZCuller() {
+    for (unsigned int i = 0; i < READBACKS; i++) {
+        if (readbacks[i].fence != 0)
+            glDeleteSync(readbacks[i].fence);
+        glDeleteBuffers(1, &readbacks[i].PBO);
+    }
+    if (reduceFBO != 0) {
+        glDeleteFramebuffers(1, &reduceFBO);
+        glDeleteTextures(1, &depthCopy);
+        glDeleteTextures(1, &reduced);
+        GLState::invalidate();
+    }
+    GLState::deleteVertexArray(emptyVAO);
+}
+
+void HiZCuller::setupShader() {
+    reduceShader.use();
+    reduceShader.setInt("depth", 0);
+}
+
+void HiZCuller::resize(int width, int height) {
+    if (reduceFBO != 0) {
+        glDeleteFramebuffers(1, &reduceFBO);
+        glDeleteTextures(1, &depthCopy);
+        glDeleteTextures(1, &reduced);
+        // the names may be reused by the next textures, GLState must not think they are still bound
+        GLState::invalidate();
+    }
+    copyWidth = width;
+    copyHeight = height;
+
+    GLState::activeTexture(GL_TEXTURE0);
+    glGenTextures(1, &depthCopy);
+    GLState::bindTexture(GL_TEXTURE_2D, depthCopy);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glGenTextures(1, &reduced);
+    GLState::bindTexture(GL_TEXTURE_2D, reduced);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, (width + BLOCK - 1) / BLOCK, (height + BLOCK - 1) / BLOCK, 0, GL_RED, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenFramebuffers(1, &reduceFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, reduceFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, reduced, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::HIZ_CULLER::FRAMEBUFFER_INCOMPLETE" << std::endl;
+}
+
+void HiZCuller::capture(GLuint framebuffer, int width, int height, const glm::mat4& viewProjection) {
+    if (width <= 0 || height <= 0)
+        return;
+    // only grows, a smaller frame (dynamic resolution) uses the lower left part
+    if (width > copyWidth || height > copyHeight)
+        resize(std::max(width, copyWidth), std::max(height, copyHeight));
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    GLState::activeTexture(GL_TEXTURE0);
+    GLState::bindTexture(GL_TEXTURE_2D, depthCopy);
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+
+    int reducedWidth = (width + BLOCK - 1) / BLOCK;
+    int reducedHeight = (height + BLOCK - 1) / BLOCK;
+    glBindFramebuffer(GL_FRAMEBUFFER, reduceFBO);
+    glViewport(0, 0, reducedWidth, reducedHeight);
+    glDisable(GL_DEPTH_TEST);
+    reduceShader.use();
+    reduceShader.set(sourceSize, glm::ivec2(width, height));
+    GLState::polygonMode(GL_FILL);
+    GLState::bindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    // a slot whose depth never got picked up is overwritten, there is a newer one now
+    Readback& readback = readbacks[nextReadback];
+    if (readback.fence != 0)
+        glDeleteSync(readback.fence);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.PBO);
+    glBufferData(GL_PIXEL_PACK_BUFFER, reducedWidth * reducedHeight * sizeof(float), NULL, GL_STREAM_READ);
+    glReadPixels(0, 0, reducedWidth, reducedHeight, GL_RED, GL_FLOAT, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readback.width = reducedWidth;
+    readback.height = reducedHeight;
+    readback.sourceWidth = width;
+    readback.sourceHeight = height;
+    readback.viewProjection = viewProjection;
+    nextReadback = (nextReadback + 1) % READBACKS;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, width, height);
+    glEnable(GL_DEPTH_TEST);
+}
+
+bool HiZCuller::update() {
+    // the newest readback the GPU has finished, without waiting for it
+    int newest = -1;
+    for (unsigned int age = 1; age <= READBACKS; age++) {
+        unsigned int slot = (nextReadback + READBACKS - age) % READBACKS;
+        if (readbacks[slot].fence == 0)
+            continue;
+        if (newest >= 0) {
+            // older than the one taken, no longer needed
+            glDeleteSync(readbacks[slot].fence);
+            readbacks[slot].fence = 0;
+            continue;
+        }
+        GLenum status = glClientWaitSync(readbacks[slot].fence, 0, 0);
+        if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+            newest = (int)slot;
+    }
+    if (newest < 0)
+        return !levels.empty();
+
+    Readback& readback = readbacks[newest];
+    glDeleteSync(readback.fence);
+    readback.fence = 0;
+
+    size_t count = (size_t)readback.width * readback.height;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.PBO);
+    const float* pixels = (const float*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, count * sizeof(float), GL_MAP_READ_BIT);
+    if (pixels != NULL) {
+        levels.resize(1);
+        levelSizes.resize(1);
+        levels[0].resize(count);
+        std::memcpy(&levels[0][0], pixels, count * sizeof(float));
+        levelSizes[0] = glm::ivec2(readback.width, readback.height);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        sourceWidth = readback.sourceWidth;
+        sourceHeight = readback.sourceHeight;
+        viewProjection = readback.viewProjection;
+        buildLevels();
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return !levels.empty();
+}
+
+void HiZCuller::buildLevels() {
+    // each level halves the one below, rounding up; the last column or row of an odd size is folded alone
+    while (levelSizes.back().x > 1 || levelSizes.back().y > 1) {
+        glm::ivec2 size = levelSizes.back();
+        glm::ivec2 next((size.x + 1) / 2, (size.y + 1) / 2);
+        levels.push_back(std::vector<float>((size_t)next.x * next.y));
+        levelSizes.push_back(next);
+        const std::vector<float>& below = levels[levels.size() - 2];
+        std::vector<float>& level = levels.back();
+        for (int y = 0; y < next.y; y++) {
+            const float* row0 = &below[(size_t)(2 * y) * size.x];
+            const float* row1 = &below[(size_t)std::min(2 * y + 1, size.y - 1) * size.x];
+            for (int x = 0; x < next.x; x++) {
+                int x0 = 2 * x;
+                int x1 = std::min(2 * x + 1, size.x - 1);
+                level[(size_t)y * next.x + x] = std::max(std::max(row0[x0], row0[x1]), std::max(row1[x0], row1[x1]));
+            }
+        }
+    }
+}
+
+float HiZCuller::farthestDepth(int level, int x0, int y0, int x1, int y1) const {
+    const std::vector<float>& depths = levels[level];
+    int width = levelSizes[level].x;
+    float farthest = 0.0f;
+    for (int y = y0; y <= y1; y++)
+        for (int x = x0; x <= x1; x++)
+            farthest = std::max(farthest, depths[(size_t)y * width + x]);
+    return farthest;
+}
+
+bool HiZCuller::isOccluded(const glm::mat4& model, const glm::vec3& aabbMin, const glm::vec3& aabbMax) const {
+    if (levels.empty())
+        return false;
+
+    // the box's corners in normalized device coordinates of the frame the pyramid was captured from
+    const glm::mat4 m = viewProjection * model;
+    float minX, minY, minZ, maxX, maxY;
+#ifdef SIMD_USE_SSE
+    // four corners at a time: x and y vary across the lanes, z is the same for each half of the box
+    const __m128 cornerX = _mm_setr_ps(aabbMin.x, aabbMax.x, aabbMin.x, aabbMax.x);
+    const __m128 cornerY = _mm_setr_ps(aabbMin.y, aabbMin.y, aabbMax.y, aabbMax.y);
+    const __m128 minW = _mm_set1_ps(MIN_CLIP_W);
+    __m128 lowX = _mm_set1_ps(INFINITY), lowY = lowX, lowZ = lowX;
+    __m128 highX = _mm_set1_ps(-INFINITY), highY = highX;
+    for (int half = 0; half < 2; half++) {
+        const float z = half == 0 ? aabbMin.z : aabbMax.z;
+        __m128 clip[4];
+        for (int row = 0; row < 4; row++)
+            clip[row] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0][row]), cornerX), _mm_mul_ps(_mm_set1_ps(m[1][row]), cornerY)),
+                                   _mm_set1_ps(m[2][row] * z + m[3][row]));
+        if (_mm_movemask_ps(_mm_cmple_ps(clip[3], minW)) != 0)
+            return false;
+        __m128 inverseW = _mm_div_ps(_mm_set1_ps(1.0f), clip[3]);
+        __m128 x = _mm_mul_ps(clip[0], inverseW);
+        __m128 y = _mm_mul_ps(clip[1], inverseW);
+        lowX = _mm_min_ps(lowX, x);
+        highX = _mm_max_ps(highX, x);
+        lowY = _mm_min_ps(lowY, y);
+        highY = _mm_max_ps(highY, y);
+        lowZ = _mm_min_ps(lowZ, _mm_mul_ps(clip[2], inverseW));
+    }
+    float lanes[5][4];
+    _mm_storeu_ps(lanes[0], lowX);
+    _mm_storeu_ps(lanes[1], lowY);
+    _mm_storeu_ps(lanes[2], lowZ);
+    _mm_storeu_ps(lanes[3], highX);
+    _mm_storeu_ps(lanes[4], highY);
+    minX = std::min(std::min(lanes[0][0], lanes[0][1]), std::min(lanes[0][2], lanes[0][3]));
+    minY = std::min(std::min(lanes[1][0], lanes[1][1]), std::min(lanes[1][2], lanes[1][3]));
+    minZ = std::min(std::min(lanes[2][0], lanes[2][1]), std::min(lanes[2][2], lanes[2][3]));
+    maxX = std::max(std::max(lanes[3][0], lanes[3][1]), std::max(lanes[3][2], lanes[3][3]));
+    maxY = std::max(std::max(lanes[4][0], lanes[4][1]), std::max(lanes[4][2], lanes[4][3]));
+#else
+    minX = minY = minZ = INFINITY;
+    maxX = maxY = -INFINITY;
+    for (int i = 0; i < 8; i++) {
+        glm::vec4 corner(i & 1 ? aabbMax.x : aabbMin.x, i & 2 ? aabbMax.y : aabbMin.y, i & 4 ? aabbMax.z : aabbMin.z, 1.0f);
+        glm::vec4 clip = m * corner;
+        if (clip.w <= MIN_CLIP_W)
+            return false;
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        minX = std::min(minX, ndc.x);
+        maxX = std::max(maxX, ndc.x);
+        minY = std::min(minY, ndc.y);
+        maxY = std::max(maxY, ndc.y);
+        minZ = std::min(minZ, ndc.z);
+    }
+#endif
+
+    // off screen is for frustum culling to decide, the pyramid knows nothing there
+    if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f)
+        return false;
+    float nearest = minZ * 0.5f + 0.5f;
+
+    // the rectangle in texels of the base level
+    const glm::ivec2 size = levelSizes[0];
+    const float toTexelsX = 0.5f * sourceWidth / BLOCK;
+    const float toTexelsY = 0.5f * sourceHeight / BLOCK;
+    int x0 = glm::clamp((int)std::floor((minX + 1.0f) * toTexelsX), 0, size.x - 1);
+    int x1 = glm::clamp((int)std::floor((maxX + 1.0f) * toTexelsX), 0, size.x - 1);
+    int y0 = glm::clamp((int)std::floor((minY + 1.0f) * toTexelsY), 0, size.y - 1);
+    int y1 = glm::clamp((int)std::floor((maxY + 1.0f) * toTexelsY), 0, size.y - 1);
+
+    // up the pyramid until the rectangle covers at most 2 x 2 texels
+    int level = 0;
+    while (level + 1 < (int)levels.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+        level++;
+    return nearest > farthestDepth(level, x0 >> level, y0 >> level, x1 >> level, y1 >> level);
+}
@@ -0,0 +1,75 @@
+#ifndef HIZ_CULLER_H
+#define HIZ_CULLER_H
+
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+
+
+// Occlusion culling against a hierarchical-Z pyramid of an earlier frame's depth buffer. After the opaque draws,
+// capture() copies the depth out of the framebuffer and folds every BLOCK x BLOCK pixels into their farthest
+// depth on the GPU (hiz_reduce.fs), then reads that small image back through a pixel buffer, fenced, so the
+// CPU never waits for it. Once it has arrived, update() builds the coarser levels, each texel the farthest of the
+// 2 x 2 below it.
+// isOccluded() projects the corners of a bounding box with the view-projection matrix that depth was drawn with
+// (four corners per SSE instruction where available), picks the level at which the box covers at most a few texels
+// and reports it hidden when its nearest point is behind the farthest depth there. The depth is a frame or two
+// old, so something that just came out from behind an occluder can show up a frame late.
+class HiZCuller {
+
+    public:
+        // scene pixels per side folded into one texel of the base level, matches hiz_reduce.fs
+        static const int BLOCK = 8;
+
+        Shader reduceShader;
+
+    public:
+        HiZCuller();
+        ~HiZCuller();
+        // takes the depth of the frame just drawn: width x height pixels at the origin of framebuffer, drawn with
+        // viewProjection
+        void capture(GLuint framebuffer, int width, int height, const glm::mat4& viewProjection);
+        // builds the pyramid from the newest depth that has arrived on the CPU, returns whether there is one
+        bool update();
+        // whether the box from aabbMin to aabbMax, placed with model, is hidden behind the pyramid's depth
+        bool isOccluded(const glm::mat4& model, const glm::vec3& aabbMin, const glm::vec3& aabbMax) const;
+        // restores sampler units, after the shader was rebuilt
+        void setupShader();
+
+    private:
+        static const unsigned int READBACKS = 3;
+
+        // one frame's depth on its way to the CPU
+        struct Readback {
+            GLuint PBO;
+            GLsync fence;           // 0 when the slot is free
+            int width, height;      // of the base level
+            int sourceWidth, sourceHeight;
+            glm::mat4 viewProjection;
+        };
+
+        unsigned int depthCopy;     // the scene depth, copied so it can be sampled
+        unsigned int reduced;       // base level, R32F
+        unsigned int reduceFBO;
+        unsigned int emptyVAO;
+        Uniform<glm::ivec2> sourceSize;
+        int copyWidth, copyHeight;
+
+        Readback readbacks[READBACKS];
+        unsigned int nextReadback;
+
+        // the pyramid on the CPU, level 0 first, rows from the bottom up like the framebuffer
+        std::vector<std::vector<float> > levels;
+        std::vector<glm::ivec2> levelSizes;
+        int sourceWidth, sourceHeight;
+        glm::mat4 viewProjection;
+
+        void resize(int width, int height);
+        void buildLevels();
+        float farthestDepth(int level, int x0, int y0, int x1, int y1) const;
+};
+
+
+#endif
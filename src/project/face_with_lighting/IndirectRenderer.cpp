@@ -0,0 +1,189 @@
+#include "IndirectRenderer.h"
+#include "SceneUniforms.h"
+
+#include <cstddef>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/model.h>
+
+
+IndirectRenderer::IndirectRenderer() : drawIdCapacity(0), geometryDirty(false), drawCount(0), multiDraws(0)
+{
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+    glGenBuffers(1, &drawIdBuffer);
+
+    GLState::bindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    // same layout as Mesh::setupMesh, only the attributes the face shaders read
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+    // one draw index per instance; baseInstance of each command selects which one its vertices see
+    glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+    glEnableVertexAttribArray(DRAW_ID_ATTRIBUTE);
+    glVertexAttribIPointer(DRAW_ID_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+    glVertexAttribDivisor(DRAW_ID_ATTRIBUTE, 1);
+    GLState::bindVertexArray(0);
+}
+
+IndirectRenderer::~IndirectRenderer() {
+    GLState::deleteVertexArray(VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    glDeleteBuffers(1, &drawIdBuffer);
+}
+
+bool IndirectRenderer::isSupported() {
+    return GLAD_GL_VERSION_4_3 != 0;
+}
+
+unsigned int IndirectRenderer::addModel(Model& model) {
+    ModelRange range;
+    range.firstMesh = (unsigned int)meshes.size();
+    range.meshCount = (unsigned int)model.meshes.size();
+    range.texture = model.textureArray.ID;
+
+    for (unsigned int i = 0; i < model.meshes.size(); i++) {
+        const Mesh& mesh = model.meshes[i];
+        MeshRange meshRange;
+        meshRange.count = (GLuint)mesh.indices.size();
+        meshRange.firstIndex = (GLuint)indices.size();
+        meshRange.baseVertex = (GLint)vertices.size();
+        meshRange.material = mesh.material;
+        meshes.push_back(meshRange);
+
+        vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+        indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end());
+    }
+
+    bool known = false;
+    for (unsigned int i = 0; i < textures.size(); i++)
+        known = known || textures[i] == range.texture;
+    if (!known)
+        textures.push_back(range.texture);
+
+    models.push_back(range);
+    geometryDirty = true;
+    return (unsigned int)models.size() - 1;
+}
+
+void IndirectRenderer::begin() {
+    instances.clear();
+}
+
+void IndirectRenderer::add(unsigned int model, const glm::mat4& transform) {
+    Instance instance;
+    instance.model = model;
+    instance.transform = transform;
+    instances.push_back(instance);
+}
+
+void IndirectRenderer::uploadGeometry() {
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.empty() ? NULL : &vertices[0], GL_STATIC_DRAW);
+    // the element buffer binding is VAO state
+    GLState::bindVertexArray(VAO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.empty() ? NULL : &indices[0], GL_STATIC_DRAW);
+    geometryDirty = false;
+}
+
+void IndirectRenderer::reserveDrawIds(unsigned int count) {
+    if (count <= drawIdCapacity)
+        return;
+    drawIdCapacity = count * 2;
+    std::vector<GLuint> ids(drawIdCapacity);
+    for (unsigned int i = 0; i < drawIdCapacity; i++)
+        ids[i] = i;
+    glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+    glBufferData(GL_ARRAY_BUFFER, ids.size() * sizeof(GLuint), &ids[0], GL_STATIC_DRAW);
+}
+
+unsigned long long IndirectRenderer::submit(Shader& shader, RingBuffer& ring) {
+    if (geometryDirty)
+        uploadGeometry();
+
+    drawCount = 0;
+    for (unsigned int i = 0; i < instances.size(); i++)
+        drawCount += models[instances[i].model].meshCount;
+    multiDraws = 0;
+    if (drawCount == 0)
+        return 0;
+
+    // commands and per-draw data are written straight into this frame's region of the ring
+    DrawCommand* commands;
+    DrawData* drawData;
+    GLintptr commandOffset = ring.allocate(drawCount * sizeof(DrawCommand), sizeof(GLuint), (void**)&commands);
+    GLintptr drawDataOffset = ring.allocate(drawCount * sizeof(DrawData), ring.getStorageAlignment(), (void**)&drawData);
+    if (commandOffset < 0 || drawDataOffset < 0) {
+        // the ring grows for the next frame, nothing is drawn in this one
+        drawCount = 0;
+        return 0;
+    }
+
+    // commands are grouped by texture array, so each group is a contiguous range for one multi-draw
+    unsigned int draw = 0;
+    unsigned long long indexCount = 0;
+    batchStart.clear();
+    for (unsigned int t = 0; t < textures.size(); t++) {
+        batchStart.push_back(draw);
+        for (unsigned int i = 0; i < instances.size(); i++) {
+            const ModelRange& model = models[instances[i].model];
+            if (model.texture != textures[t])
+                continue;
+            glm::mat3 normalMatrix = computeNormalMatrix(instances[i].transform);
+            for (unsigned int m = model.firstMesh; m < model.firstMesh + model.meshCount; m++, draw++) {
+                const MeshRange& mesh = meshes[m];
+                DrawCommand& command = commands[draw];
+                command.count = mesh.count;
+                indexCount += mesh.count;
+                command.instanceCount = 1;
+                command.firstIndex = mesh.firstIndex;
+                command.baseVertex = mesh.baseVertex;
+                command.baseInstance = draw;
+
+                DrawData& data = drawData[draw];
+                data.model = instances[i].transform;
+                packNormalMatrix(normalMatrix, data.normalMatrix);
+                data.diffuseColor = glm::vec4(mesh.material.diffuseColor, 1.0f);
+                data.layers = glm::ivec4(mesh.material.diffuseLayer, mesh.material.specularLayer, 0, 0);
+            }
+        }
+    }
+    batchStart.push_back(draw);
+    ring.flush(commandOffset, drawCount * sizeof(DrawCommand));
+    ring.flush(drawDataOffset, drawCount * sizeof(DrawData));
+
+    reserveDrawIds(drawCount);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, ring.ID);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, ring.ID, drawDataOffset, drawCount * sizeof(DrawData));
+
+    shader.use();
+    GLState::polygonMode(GL_FILL);
+    GLState::bindVertexArray(VAO);
+    GLState::activeTexture(GL_TEXTURE0);
+    for (unsigned int t = 0; t < textures.size(); t++) {
+        GLsizei count = (GLsizei)(batchStart[t + 1] - batchStart[t]);
+        if (count == 0)
+            continue;
+        GLState::bindTexture(GL_TEXTURE_2D_ARRAY, textures[t]);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(commandOffset + batchStart[t] * sizeof(DrawCommand)), count, 0);
+        multiDraws++;
+    }
+    return indexCount;
+}
+
+unsigned int IndirectRenderer::getDrawCount() const {
+    return drawCount;
+}
+
+unsigned int IndirectRenderer::getMultiDrawCount() const {
+    return multiDraws;
+}
@@ -0,0 +1,103 @@
+#ifndef INDIRECT_RENDERER_H
+#define INDIRECT_RENDERER_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <learnopengl/mesh.h>
+
+#include "RingBuffer.h"
+
+class Model;
+
+// binding point of the per-draw shader storage buffer read by face_indirect.vs
+const unsigned int DRAW_DATA_BINDING = 0;
+// vertex attribute that carries the draw index, fed from baseInstance of each indirect command
+const unsigned int DRAW_ID_ATTRIBUTE = 5;
+
+
+// Submission backend that draws whole scenes with glMultiDrawElementsIndirect. The meshes of all added models share
+// one vertex and one index buffer, every mesh instance becomes one indirect command, and its transform and material
+// go into a shader storage buffer indexed by the draw. Each texture array needs one multi-draw call.
+// Needs OpenGL 4.3, which Mesa's llvmpipe provides, so it runs in headless CI as well.
+class IndirectRenderer {
+
+    // layout of DrawElementsIndirectCommand as defined by GL
+    struct DrawCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint  baseVertex;
+        GLuint baseInstance;
+    };
+
+    // std430 layout of one element of Draws.draws in face_indirect.vs
+    struct DrawData {
+        glm::mat4 model;
+        glm::vec4 normalMatrix[3];  // mat3, every column padded to a vec4
+        glm::vec4 diffuseColor; // rgb used
+        glm::ivec4 layers;      // x: diffuse layer, y: specular layer, -1 for none
+    };
+
+    struct MeshRange {
+        GLuint count;
+        GLuint firstIndex;
+        GLint baseVertex;
+        Material material;
+    };
+
+    struct ModelRange {
+        unsigned int firstMesh;
+        unsigned int meshCount;
+        unsigned int texture;
+    };
+
+    struct Instance {
+        unsigned int model;
+        glm::mat4 transform;
+    };
+
+    public:
+        IndirectRenderer();
+        ~IndirectRenderer();
+        // whether the current context is OpenGL 4.3 or newer, which the context has to be created asking for
+        static bool isSupported();
+        // copies the meshes of a model into the shared buffers and returns the handle to draw it with
+        unsigned int addModel(Model& model);
+        // starts a new frame
+        void begin();
+        // queues one instance of a model added before
+        void add(unsigned int model, const glm::mat4& transform);
+        // writes commands and per-draw data into the ring and issues one multi-draw per texture array. Returns the
+        // indices drawn, 0 if the frame's region of the ring had no room for the commands
+        unsigned long long submit(Shader& shader, RingBuffer& ring);
+
+        unsigned int getDrawCount() const;
+        unsigned int getMultiDrawCount() const;
+
+    private:
+        unsigned int VAO;
+        unsigned int VBO;
+        unsigned int EBO;
+        unsigned int drawIdBuffer;
+        unsigned int drawIdCapacity;
+        bool geometryDirty;
+
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        std::vector<MeshRange> meshes;
+        std::vector<ModelRange> models;
+        std::vector<unsigned int> textures;     // distinct texture arrays, one multi-draw each
+        std::vector<Instance> instances;
+
+        std::vector<unsigned int> batchStart;   // first command of each texture array
+        unsigned int drawCount;
+        unsigned int multiDraws;
+
+        void uploadGeometry();
+        void reserveDrawIds(unsigned int count);
+};
+
+
+#endif
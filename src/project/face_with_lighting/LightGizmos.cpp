@@ -0,0 +1,66 @@
+#include "LightGizmos.h"
+
+#include <cstring>
+
+#include <learnopengl/gl_state.h>
+
+
+LightGizmos::LightGizmos(const Sphere& sphere) : indexCount((GLsizei)sphere.Indices.size()), drawn(0)
+{
+    glGenVertexArrays(1, &VAO);
+    GLState::bindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, sphere.VBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphere.EBO);
+    // only the positions, the gizmos are unlit
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(sphere.vertices[0]), (void*)0);
+    glEnableVertexAttribArray(GIZMO_PLACEMENT_ATTRIBUTE);
+    glVertexAttribDivisor(GIZMO_PLACEMENT_ATTRIBUTE, 1);
+    glEnableVertexAttribArray(GIZMO_COLOR_ATTRIBUTE);
+    glVertexAttribDivisor(GIZMO_COLOR_ATTRIBUTE, 1);
+    GLState::bindVertexArray(0);
+}
+
+LightGizmos::~LightGizmos() {
+    GLState::deleteVertexArray(VAO);
+}
+
+void LightGizmos::begin() {
+    instances.clear();
+}
+
+void LightGizmos::add(const glm::vec3& position, float radius, const glm::vec3& color) {
+    Instance instance;
+    instance.placement = glm::vec4(position, radius);
+    instance.color = glm::vec4(color, 1.0f);
+    instances.push_back(instance);
+}
+
+void LightGizmos::submit(Shader& shader, RingBuffer& ring) {
+    drawn = 0;
+    if (instances.empty())
+        return;
+
+    Instance* data;
+    GLsizeiptr size = instances.size() * sizeof(Instance);
+    GLintptr offset = ring.allocate(size, sizeof(glm::vec4), (void**)&data);
+    if (offset < 0)
+        return;
+    std::memcpy(data, &instances[0], size);
+    ring.flush(offset, size);
+
+    GLState::bindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, ring.ID);
+    glVertexAttribPointer(GIZMO_PLACEMENT_ATTRIBUTE, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)offset);
+    glVertexAttribPointer(GIZMO_COLOR_ATTRIBUTE, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(offset + sizeof(glm::vec4)));
+
+    shader.use();
+    // drawn as wireframe, whoever draws next sets the polygon mode it needs through GLState
+    GLState::polygonMode(GL_LINE);
+    glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0, (GLsizei)instances.size());
+    drawn = (unsigned int)instances.size();
+}
+
+unsigned int LightGizmos::getCount() const {
+    return drawn;
+}
@@ -0,0 +1,51 @@
+#ifndef LIGHT_GIZMOS_H
+#define LIGHT_GIZMOS_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+
+#include "RingBuffer.h"
+#include "Sphere.h"
+
+// vertex attributes of light_shader.vs fed per instance: position and size, then colour
+const unsigned int GIZMO_PLACEMENT_ATTRIBUTE = 3;
+const unsigned int GIZMO_COLOR_ATTRIBUTE = 4;
+
+
+// Draws a wireframe sphere at every light with one glDrawElementsInstanced. The lights queued during a frame are
+// written into the ring as an instance buffer of position, size and colour, and light_shader.vs places and colours
+// each instance of the sphere from it, so a thousand lights cost one draw like one light does.
+// The sphere's vertex and index buffers are shared through a vertex array of its own, which adds the per-instance
+// attributes; their pointers move to this frame's part of the ring at every submit.
+class LightGizmos {
+
+    // one element of the instance buffer
+    struct Instance {
+        glm::vec4 placement;    // xyz: center, w: radius
+        glm::vec4 color;        // rgb used
+    };
+
+    public:
+        LightGizmos(const Sphere& sphere);
+        ~LightGizmos();
+        // starts a new frame
+        void begin();
+        // queues a sphere of the given radius around a light
+        void add(const glm::vec3& position, float radius, const glm::vec3& color);
+        // writes the queued instances into the ring and draws them all with shader
+        void submit(Shader& shader, RingBuffer& ring);
+
+        // spheres drawn by the last submit
+        unsigned int getCount() const;
+
+    private:
+        unsigned int VAO;
+        GLsizei indexCount;
+        std::vector<Instance> instances;
+        unsigned int drawn;
+};
+
+
+#endif
@@ -0,0 +1,153 @@
+#include "PointShadowMap.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/gl_state.h>
+
+#include "SceneUniforms.h"
+
+// the shadow projection starts this close to the light
+const float SHADOW_NEAR_PLANE = 0.01f;
+
+
+PointShadowMap::PointShadowMap(unsigned int size, bool layered)
+    : layered(layered), size(size), valid(false), cachedPosition(0.0f), cachedFarPlane(0.0f), renderCount(0)
+{
+    if (layered) {
+        shader.reset(new Shader("shadow_depth.vs", "shadow_depth.fs", "shadow_depth.gs", std::vector<std::string>(1, "LAYERED")));
+        GLint linked = GL_FALSE;
+        glGetProgramiv(shader->ID, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            std::cout << "ERROR::POINT_SHADOW_MAP::LAYERED_PROGRAM_FAILED, rendering the cube faces in six passes" << std::endl;
+            this->layered = false;
+        }
+    }
+    if (!this->layered)
+        shader.reset(new Shader("shadow_depth.vs", "shadow_depth.fs"));
+    setupShader();
+
+    glGenTextures(1, &cubeMap);
+    GLState::activeTexture(GL_TEXTURE0 + SHADOW_MAP_UNIT);
+    GLState::bindTexture(GL_TEXTURE_CUBE_MAP, cubeMap);
+    for (unsigned int face = 0; face < 6; face++)
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    // linear filtering with depth comparison gives 2x2 percentage closer filtering in hardware
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+    glGenFramebuffers(1, &FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    if (this->layered)
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cubeMap, 0);
+    else
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X, cubeMap, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::POINT_SHADOW_MAP::FRAMEBUFFER_INCOMPLETE" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+PointShadowMap::~PointShadowMap() {
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteTextures(1, &cubeMap);
+    // the name may be reused by the next texture, GLState must not think it is still bound
+    GLState::invalidate();
+}
+
+void PointShadowMap::setupShader() {
+    // the casters are drawn through the render queue, which passes their model matrices in the Object block
+    shader->bindUniformBlock("Object", OBJECT_BLOCK_BINDING);
+    for (unsigned int face = 0; face < 6; face++)
+        faceMatrices[face] = shader->uniform<glm::mat4>("faceMatrices[" + std::to_string(face) + "]");
+    faceMatrix = shader->uniform<glm::mat4>("faceMatrix");
+    lightPosition = shader->uniform<glm::vec3>("lightPosition");
+    farPlane = shader->uniform<float>("farPlane");
+    valid = false;
+}
+
+Shader& PointShadowMap::getShader() {
+    return *shader;
+}
+
+bool PointShadowMap::isLayered() const {
+    return layered;
+}
+
+bool PointShadowMap::needsUpdate(const glm::vec3& position, float farPlane) const {
+    return !valid || position != cachedPosition || farPlane != cachedFarPlane;
+}
+
+void PointShadowMap::render(const glm::vec3& position, float farPlane, const std::function<void()>& drawCasters) {
+    // the faces in the order of GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, with the up vectors cube maps are addressed with
+    static const glm::vec3 directions[6] = {
+        glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+        glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+    };
+    static const glm::vec3 ups[6] = {
+        glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f),
+        glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+    };
+    glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, SHADOW_NEAR_PLANE, farPlane);
+    glm::mat4 matrices[6];
+    for (unsigned int face = 0; face < 6; face++)
+        matrices[face] = projection * glm::lookAt(position, position + directions[face], ups[face]);
+
+    // the scene may be drawn into an offscreen target, which is bound again afterwards
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    GLint target = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glViewport(0, 0, size, size);
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_TRUE);
+
+    shader->use();
+    shader->set(lightPosition, position);
+    shader->set(this->farPlane, farPlane);
+    if (layered) {
+        for (unsigned int face = 0; face < 6; face++)
+            shader->set(faceMatrices[face], matrices[face]);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        drawCasters();
+    } else {
+        for (unsigned int face = 0; face < 6; face++) {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, cubeMap, 0);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            shader->use();
+            shader->set(faceMatrix, matrices[face]);
+            drawCasters();
+        }
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+    valid = true;
+    cachedPosition = position;
+    cachedFarPlane = farPlane;
+    renderCount++;
+}
+
+void PointShadowMap::invalidate() {
+    valid = false;
+}
+
+void PointShadowMap::bind() {
+    GLState::activeTexture(GL_TEXTURE0 + SHADOW_MAP_UNIT);
+    GLState::bindTexture(GL_TEXTURE_CUBE_MAP, cubeMap);
+}
+
+unsigned int PointShadowMap::getRenderCount() const {
+    return renderCount;
+}
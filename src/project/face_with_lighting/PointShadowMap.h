@@ -0,0 +1,64 @@
+#ifndef POINT_SHADOW_MAP_H
+#define POINT_SHADOW_MAP_H
+
+#include <functional>
+#include <memory>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+
+// texture unit the face shaders read the shadow cube map from, unit 0 holds the model's texture array
+const unsigned int SHADOW_MAP_UNIT = 1;
+
+
+// Omnidirectional shadows of one point light. The distance from the light to the nearest caster is rendered into a
+// depth cube map, divided by the light's far plane, and the face shaders compiled with POINT_SHADOWS compare
+// against it through a samplerCubeShadow (see lighting.glsl). The six faces are drawn in one pass, with a geometry
+// shader sending each triangle to every layer, or in six passes if layered rendering is turned off or its program
+// does not link.
+// The map is cached: it is only rendered again when the light moved, its far plane changed or invalidate() was
+// called, so with static casters a paused light costs nothing.
+class PointShadowMap {
+
+    public:
+        PointShadowMap(unsigned int size = 1024, bool layered = true);
+        ~PointShadowMap();
+        // the program the casters have to be drawn with
+        Shader& getShader();
+        bool isLayered() const;
+        // whether the cached map is out of date for a light at position whose shadows reach up to farPlane
+        bool needsUpdate(const glm::vec3& position, float farPlane) const;
+        // renders the map; drawCasters issues the draws of all casters with getShader(), once, or once per face
+        // without layered rendering
+        void render(const glm::vec3& position, float farPlane, const std::function<void()>& drawCasters);
+        // the next needsUpdate() returns true, e.g. after casters moved or the shaders were rebuilt
+        void invalidate();
+        // restores the block binding and uniform handles of the program and invalidates the map, after the program
+        // was rebuilt
+        void setupShader();
+        // binds the cube map to SHADOW_MAP_UNIT
+        void bind();
+
+        // how often the map was rendered
+        unsigned int getRenderCount() const;
+
+    private:
+        std::unique_ptr<Shader> shader;
+        bool layered;
+        unsigned int size;
+        unsigned int cubeMap;
+        unsigned int FBO;
+        Uniform<glm::mat4> faceMatrices[6];     // layered program
+        Uniform<glm::mat4> faceMatrix;          // one pass per face
+        Uniform<glm::vec3> lightPosition;
+        Uniform<float> farPlane;
+
+        bool valid;
+        glm::vec3 cachedPosition;
+        float cachedFarPlane;
+        unsigned int renderCount;
+};
+
+
+#endif
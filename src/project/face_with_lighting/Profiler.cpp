@@ -0,0 +1,201 @@
+#include "Profiler.h"
+
+#include <cstdio>
+#include <iostream>
+
+
+Profiler::Profiler()
+    : origin(std::chrono::steady_clock::now()), frames(HISTORY_FRAMES), frameCount(0), gpuOffset(0.0), calibrated(false)
+{
+    // timer queries are core since 3.3, debug groups since 4.3 or with KHR_debug
+    gpuTimers = GLAD_GL_VERSION_3_3 != 0;
+    debugGroups = GLAD_GL_VERSION_4_3 != 0 || GLAD_GL_KHR_debug != 0;
+
+    Frame& startup = frames[0];
+    startup.number = 0;
+    startup.unresolved = 0;
+    startFrame(startup);
+}
+
+Profiler::~Profiler() {
+    for (unsigned int i = 0; i < frames.size(); i++) {
+        if (frames[i].calibration != 0)
+            glDeleteQueries(1, &frames[i].calibration);
+        for (unsigned int e = 0; e < frames[i].events.size(); e++)
+            if (frames[i].events[e].queries[0] != 0)
+                glDeleteQueries(2, frames[i].events[e].queries);
+    }
+    if (!freeQueries.empty())
+        glDeleteQueries((GLsizei)freeQueries.size(), &freeQueries[0]);
+}
+
+double Profiler::now() const {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - origin).count();
+}
+
+Profiler::Frame& Profiler::current() {
+    return frames[frameCount % HISTORY_FRAMES];
+}
+
+bool Profiler::hasGpuTimers() const {
+    return gpuTimers;
+}
+
+bool Profiler::hasDebugGroups() const {
+    return debugGroups;
+}
+
+void Profiler::beginFrame() {
+    // scopes left open by the caller are closed with the frame
+    while (!open.empty())
+        end(open.back());
+
+    // results of earlier frames that are ready by now, oldest first; timestamps complete in order, so the first
+    // frame that is still waiting ends the search
+    unsigned int oldest = frameCount >= HISTORY_FRAMES - 1 ? frameCount - (HISTORY_FRAMES - 1) : 0;
+    for (unsigned int number = oldest; number <= frameCount; number++)
+        if (!resolve(frames[number % HISTORY_FRAMES], false))
+            break;
+
+    frameCount++;
+    Frame& frame = current();
+    // the oldest frame of the ring is overwritten, normally its results were read long ago
+    resolve(frame, true);
+    frame.number = frameCount;
+    frame.events.clear();
+    startFrame(frame);
+}
+
+void Profiler::startFrame(Frame& frame) {
+    frame.start = now();
+    frame.calibration = 0;
+    if (gpuTimers) {
+        // read back with the frame's scopes; glGetInteger64v(GL_TIMESTAMP) would be exact but waits for the GPU
+        frame.calibration = allocateQuery();
+        glQueryCounter(frame.calibration, GL_TIMESTAMP);
+        frame.unresolved++;
+    }
+}
+
+unsigned int Profiler::begin(const char* name, bool gpu) {
+    Frame& frame = current();
+    Event event;
+    event.name = name;
+    event.gpu = gpu && gpuTimers;
+    event.group = gpu && debugGroups;
+    event.queries[0] = event.queries[1] = 0;
+    if (event.gpu) {
+        event.queries[0] = allocateQuery();
+        event.queries[1] = allocateQuery();
+        glQueryCounter(event.queries[0], GL_TIMESTAMP);
+        frame.unresolved++;
+    }
+    if (event.group)
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+    event.start = now();
+    event.end = -1.0;
+    frame.events.push_back(event);
+    open.push_back((unsigned int)frame.events.size() - 1);
+    return open.back();
+}
+
+void Profiler::end(unsigned int scope) {
+    Frame& frame = current();
+    // a scope that outlived its frame was already closed by beginFrame()
+    if (open.empty() || open.back() != scope)
+        return;
+    open.pop_back();
+    Event& event = frame.events[scope];
+    event.end = now();
+    if (event.gpu)
+        glQueryCounter(event.queries[1], GL_TIMESTAMP);
+    if (event.group)
+        glPopDebugGroup();
+}
+
+GLuint Profiler::allocateQuery() {
+    if (freeQueries.empty()) {
+        freeQueries.resize(64);
+        glGenQueries(64, &freeQueries[0]);
+    }
+    GLuint query = freeQueries.back();
+    freeQueries.pop_back();
+    return query;
+}
+
+bool Profiler::resolve(Frame& frame, bool wait) {
+    if (frame.unresolved == 0)
+        return true;
+    if (!wait) {
+        // the last timestamp of the frame is written last
+        GLuint last = frame.calibration;
+        for (unsigned int i = (unsigned int)frame.events.size(); i-- > 0;)
+            if (frame.events[i].queries[1] != 0) {
+                last = frame.events[i].queries[1];
+                break;
+            }
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(last, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return false;
+    }
+    if (frame.calibration != 0) {
+        // the GPU reaches the query only after the CPU issued it, so every frame gives a lower bound on the offset
+        // between the clocks; the largest one, from a frame the GPU was idle for, is closest
+        GLuint64 gpuStart = 0;
+        glGetQueryObjectui64v(frame.calibration, GL_QUERY_RESULT, &gpuStart);
+        double offset = frame.start - (double)gpuStart / 1000.0;
+        if (!calibrated || offset > gpuOffset)
+            gpuOffset = offset;
+        calibrated = true;
+        freeQueries.push_back(frame.calibration);
+        frame.calibration = 0;
+    }
+    for (unsigned int i = 0; i < frame.events.size(); i++) {
+        Event& event = frame.events[i];
+        if (event.queries[0] == 0)
+            continue;
+        GLuint64 start = 0, end = 0;
+        glGetQueryObjectui64v(event.queries[0], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(event.queries[1], GL_QUERY_RESULT, &end);
+        event.start = (double)start / 1000.0;
+        event.end = (double)end / 1000.0;
+        freeQueries.push_back(event.queries[0]);
+        freeQueries.push_back(event.queries[1]);
+        event.queries[0] = event.queries[1] = 0;
+    }
+    frame.unresolved = 0;
+    return true;
+}
+
+bool Profiler::writeChromeTrace(const std::string& path) {
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (file == NULL) {
+        std::cout << "ERROR::PROFILER::CANNOT_WRITE " << path << std::endl;
+        return false;
+    }
+
+    // CPU scopes go on thread 1, GPU scopes on thread 2; "X" events carry their duration, so nesting needs no pairing
+    std::fprintf(file, "{\"traceEvents\":[\n");
+    std::fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n");
+    std::fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+    // the current frame only once all of its scopes have ended, e.g. after the render loop
+    unsigned int first = frameCount >= HISTORY_FRAMES - 1 ? frameCount - (HISTORY_FRAMES - 1) : 0;
+    unsigned int last = open.empty() ? frameCount + 1 : frameCount;
+    for (unsigned int number = first; number < last; number++) {
+        Frame& frame = frames[number % HISTORY_FRAMES];
+        resolve(frame, true);
+        for (unsigned int i = 0; i < frame.events.size(); i++) {
+            const Event& event = frame.events[i];
+            double start = event.gpu ? event.start + gpuOffset : event.start;
+            std::fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%u}}",
+                         event.name, event.gpu ? "gpu" : "cpu", event.gpu ? 2 : 1, start, event.end - event.start, frame.number);
+        }
+    }
+    std::fprintf(file, "\n]}\n");
+    bool written = std::ferror(file) == 0;
+    std::fclose(file);
+    if (!written)
+        std::cout << "ERROR::PROFILER::CANNOT_WRITE " << path << std::endl;
+    return written;
+}
@@ -0,0 +1,104 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+
+
+// Frame profiler. Code marks what it does with ProfileScope objects, which time the CPU from construction to
+// destruction and, for GPU scopes, also the commands issued in between: a timestamp query is written at both ends
+// and the work shows up as a named group in GPU debuggers (KHR_debug). Timer results arrive a few frames late; they
+// are collected without waiting once the GPU has written them, so profiling never stalls the pipeline.
+// The last HISTORY_FRAMES frames are kept and can be written as a Chrome trace (chrome://tracing, ui.perfetto.dev),
+// with the CPU scopes on one track and the GPU scopes, moved onto the CPU clock, on another. The offset between the
+// clocks comes from a timestamp query written at the start of every frame next to the CPU time, so lining them up
+// never waits for the GPU either.
+class Profiler {
+
+    public:
+        static const unsigned int HISTORY_FRAMES = 300;
+
+    public:
+        Profiler();
+        ~Profiler();
+        // closes the current frame and starts the next one; scopes before the first call go into a startup frame
+        void beginFrame();
+        // opens a scope and returns its handle for end(); gpu scopes need a current context
+        unsigned int begin(const char* name, bool gpu);
+        void end(unsigned int scope);
+        // writes the recorded frames as Chrome trace event JSON, waiting for any timer result still outstanding
+        bool writeChromeTrace(const std::string& path);
+
+        // whether the context has timer queries and debug groups
+        bool hasGpuTimers() const;
+        bool hasDebugGroups() const;
+
+    private:
+        struct Event {
+            const char* name;           // string literals only, events keep the pointer
+            double start;               // microseconds since the profiler was created
+            double end;                 // negative while the scope is open
+            bool gpu;
+            bool group;                 // a debug group was pushed for it
+            GLuint queries[2];          // timestamp queries, 0 until the scope was resolved or for CPU scopes
+        };
+
+        struct Frame {
+            unsigned int number;
+            double start;
+            GLuint calibration;         // timestamp query issued at start, 0 once read
+            unsigned int unresolved;    // timer queries of the frame that have not been read yet, calibration included
+            std::vector<Event> events;  // GPU scopes hold GPU time until the trace is written
+        };
+
+        std::chrono::steady_clock::time_point origin;
+        bool gpuTimers;
+        bool debugGroups;
+        std::vector<Frame> frames;      // ring of HISTORY_FRAMES
+        unsigned int frameCount;        // frames begun, the current one is frames[frameCount % HISTORY_FRAMES]
+        std::vector<unsigned int> open; // scopes of the current frame that have not ended, innermost last
+        std::vector<GLuint> freeQueries;
+        double gpuOffset;               // added to GPU timestamps in microseconds to move them onto the CPU clock
+        bool calibrated;
+
+        double now() const;
+        Frame& current();
+        void startFrame(Frame& frame);
+        GLuint allocateQuery();
+        // reads the timer results of a frame; with wait false only if the GPU already wrote all of them.
+        // Returns whether the frame has no results left to read.
+        bool resolve(Frame& frame, bool wait);
+};
+
+
+// times its own lifetime in the given profiler, on the GPU too if gpu is set
+class ProfileScope {
+
+    public:
+        ProfileScope(Profiler& profiler, const char* name, bool gpu = false)
+            : profiler(profiler), scope(profiler.begin(name, gpu)), ended(false)
+        {
+        }
+        ~ProfileScope() {
+            end();
+        }
+        // ends the scope early, for spans that declare what is used after them
+        void end() {
+            if (!ended)
+                profiler.end(scope);
+            ended = true;
+        }
+
+    private:
+        Profiler& profiler;
+        unsigned int scope;
+        bool ended;
+
+        ProfileScope(const ProfileScope&);
+        ProfileScope& operator=(const ProfileScope&);
+};
+
+
+#endif
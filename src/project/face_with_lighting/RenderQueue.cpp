@@ -0,0 +1,315 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/model.h>
+
+#include "SceneUniforms.h"
+#include "HiZCuller.h"
+
+
+RenderQueue::RenderQueue() : view(1.0f), farPlane(100.0f), depthShader(NULL), culler(NULL), meshCount(0), culledCount(0), indexCount(0), countSamples(false), queryFrame(0)
+{
+    for (unsigned int f = 0; f < QUERY_FRAMES; f++)
+        for (unsigned int p = 0; p < PASS_COUNT; p++) {
+            queries[f][p] = 0;
+            queryPending[f][p] = false;
+        }
+    for (unsigned int p = 0; p < PASS_COUNT; p++)
+        samples[p] = 0;
+}
+
+RenderQueue::~RenderQueue() {
+    if (queries[0][0] != 0)
+        glDeleteQueries(QUERY_FRAMES * PASS_COUNT, &queries[0][0]);
+}
+
+void RenderQueue::setDepthPrepass(Shader* depthShader) {
+    this->depthShader = depthShader;
+}
+
+bool RenderQueue::hasDepthPrepass() const {
+    return depthShader != NULL;
+}
+
+void RenderQueue::setCountSamples(bool count) {
+    if (count && queries[0][0] == 0)
+        glGenQueries(QUERY_FRAMES * PASS_COUNT, &queries[0][0]);
+    countSamples = count;
+}
+
+GLuint RenderQueue::getSamples(Pass pass) const {
+    return samples[pass];
+}
+
+unsigned int RenderQueue::getSampleLatency() {
+    // the slot about to be reused is waited for, so no result is older than the ring
+    return QUERY_FRAMES + 1;
+}
+
+void RenderQueue::setOcclusionCuller(const HiZCuller* culler) {
+    this->culler = culler;
+}
+
+unsigned int RenderQueue::getMeshCount() const {
+    return meshCount;
+}
+
+unsigned int RenderQueue::getCulledCount() const {
+    return culledCount;
+}
+
+unsigned long long RenderQueue::getIndexCount() const {
+    return indexCount;
+}
+
+void RenderQueue::begin(const glm::mat4& view, float farPlane) {
+    this->view = view;
+    this->farPlane = farPlane;
+    packets.clear();
+    meshCount = 0;
+    culledCount = 0;
+    indexCount = 0;
+}
+
+void RenderQueue::add(Shader& shader, unsigned int VAO, GLsizei indexCount, GLenum polygonMode, const glm::mat4& model, const glm::vec3& center) {
+    push(PASS_OPAQUE, shader, NULL, VAO, indexCount, polygonMode, 0, model, computeNormalMatrix(model), center);
+}
+
+void RenderQueue::add(Shader& shader, Model& object, const glm::mat4& model, const unsigned char* visible) {
+    glm::mat3 normalMatrix = computeNormalMatrix(model);
+    for (unsigned int i = 0; i < object.meshes.size(); i++)
+        if (visible == NULL || visible[i])
+            pushMesh(shader, object.meshes[i], object.textureArray.ID, model, normalMatrix);
+}
+
+void RenderQueue::add(ShaderVariants& variants, Model& object, const glm::mat4& model, const unsigned char* visible) {
+    glm::mat3 normalMatrix = computeNormalMatrix(model);
+    for (unsigned int i = 0; i < object.meshes.size(); i++) {
+        if (visible != NULL && !visible[i])
+            continue;
+        Mesh& mesh = object.meshes[i];
+        pushMesh(mesh.selectShader(variants), mesh, object.textureArray.ID, model, normalMatrix);
+    }
+}
+
+void RenderQueue::pushMesh(Shader& shader, Mesh& mesh, unsigned int texture, const glm::mat4& model, const glm::mat3& normalMatrix) {
+    meshCount++;
+    if (culler != NULL && culler->isOccluded(model, mesh.aabbMin, mesh.aabbMax)) {
+        culledCount++;
+        return;
+    }
+    glm::vec3 center = (mesh.aabbMin + mesh.aabbMax) * 0.5f;
+    GLsizei indexCount = (GLsizei)mesh.indices.size();
+    if (depthShader != NULL)
+        push(PASS_DEPTH, *depthShader, NULL, mesh.depthVAO, indexCount, GL_FILL, 0, model, normalMatrix, center);
+    push(PASS_OPAQUE, shader, &mesh, mesh.VAO, indexCount, GL_FILL, texture, model, normalMatrix, center);
+    packets.back().prepassed = depthShader != NULL;
+}
+
+void RenderQueue::push(Pass pass, Shader& shader, Mesh* mesh, unsigned int VAO, GLsizei indexCount, GLenum polygonMode, unsigned int texture,
+                       const glm::mat4& model, const glm::mat3& normalMatrix, const glm::vec3& center) {
+    DrawPacket packet;
+    packet.shader = &shader;
+    packet.mesh = mesh;
+    packet.VAO = VAO;
+    packet.indexCount = indexCount;
+    packet.polygonMode = polygonMode;
+    packet.prepassed = false;
+    packet.texture = texture;
+    packet.model = model;
+    packet.normalMatrix = normalMatrix;
+
+    float depth = -(view * model * glm::vec4(center, 1.0f)).z;
+    packet.key = makeKey(pass, programIndex(shader), textureIndex(texture), depth, VAO);
+    packets.push_back(packet);
+}
+
+uint64_t RenderQueue::makeKey(Pass pass, unsigned int program, unsigned int texture, float depth, unsigned int VAO) const {
+    // quantize the view depth to 24 bits, everything behind the camera or past the far plane is clamped
+    float normalized = depth / farPlane;
+    if (normalized < 0.0f) normalized = 0.0f;
+    if (normalized > 1.0f) normalized = 1.0f;
+    uint64_t quantized = (uint64_t)(normalized * 16777215.0f);
+
+    return ((uint64_t)(pass & 0x3) << 62)
+         | ((uint64_t)(program & 0x3FF) << 52)
+         | ((uint64_t)(texture & 0xFFF) << 40)
+         | (quantized << 16)
+         | (uint64_t)(VAO & 0xFFFF);
+}
+
+unsigned int RenderQueue::programIndex(Shader& shader) {
+    // one entry per Shader, so its index stays small and the same across reloads; a rebuilt program replaces
+    // the one its entry was resolved for
+    unsigned int i = 0;
+    while (i < programs.size() && programs[i].shader != &shader)
+        i++;
+    if (i == programs.size()) {
+        programs.push_back(ProgramEntry());
+        programs[i].shader = &shader;
+        programs[i].program = 0;
+    }
+    ProgramEntry& entry = programs[i];
+    if (entry.program != shader.ID) {
+        entry.program = shader.ID;
+        entry.textures = shader.uniform<int>("material.textures");
+        // the texture array is always bound to unit 0, so the sampler only has to be set once per program
+        shader.use();
+        shader.set(entry.textures, 0);
+    }
+    return i;
+}
+
+unsigned int RenderQueue::textureIndex(unsigned int texture) {
+    for (unsigned int i = 0; i < textures.size(); i++)
+        if (textures[i] == texture)
+            return i;
+    textures.push_back(texture);
+    return (unsigned int)textures.size() - 1;
+}
+
+void RenderQueue::sort() {
+    unsigned int n = (unsigned int)packets.size();
+    items.resize(n);
+    scratch.resize(n);
+    for (unsigned int i = 0; i < n; i++) {
+        items[i].key = packets[i].key;
+        items[i].packet = i;
+    }
+    if (n < 2)
+        return;
+
+    // LSD radix sort, one byte per pass. It is stable, so equal keys keep their submission order.
+    for (unsigned int shift = 0; shift < 64; shift += 8) {
+        unsigned int count[256] = { 0 };
+        for (unsigned int i = 0; i < n; i++)
+            count[(items[i].key >> shift) & 0xFF]++;
+        // all keys share this byte, the pass would not change anything
+        if (count[(items[0].key >> shift) & 0xFF] == n)
+            continue;
+
+        unsigned int offset = 0;
+        for (unsigned int b = 0; b < 256; b++) {
+            unsigned int c = count[b];
+            count[b] = offset;
+            offset += c;
+        }
+        for (unsigned int i = 0; i < n; i++)
+            scratch[count[(items[i].key >> shift) & 0xFF]++] = items[i];
+        items.swap(scratch);
+    }
+}
+
+void RenderQueue::submit(RingBuffer& ring) {
+    if (packets.empty())
+        return;
+
+    // per-draw data goes into the ring in one linear pass, the draws then only move the block's offset
+    GLsizeiptr alignment = ring.getUniformAlignment();
+    GLsizeiptr stride = (sizeof(ObjectBlock) + alignment - 1) / alignment * alignment;
+    unsigned char* data;
+    unsigned int count = (unsigned int)items.size();
+    GLintptr offset = ring.allocate(stride * count, alignment, (void**)&data);
+    if (offset < 0) {
+        // the ring grows for the next frame; this one draws as many packets as still fit, in sorted order
+        count = (unsigned int)std::min((GLsizeiptr)count, ring.getAvailable(alignment) / stride);
+        if (count == 0)
+            return;
+        offset = ring.allocate(stride * count, alignment, (void**)&data);
+    }
+    for (unsigned int i = 0; i < count; i++) {
+        DrawPacket& packet = packets[items[i].packet];
+        ObjectBlock* object = (ObjectBlock*)(data + i * stride);
+        object->model = packet.model;
+        packNormalMatrix(packet.normalMatrix, object->normalMatrix);
+        packet.object = offset + i * stride;
+    }
+    ring.flush(offset, stride * count);
+
+    if (countSamples)
+        collectSamples();
+
+    // items are sorted by pass first, so each pass is one contiguous run
+    int pass = -1;
+    bool equalDepth = false;
+    for (unsigned int i = 0; i < count; i++) {
+        DrawPacket& packet = packets[items[i].packet];
+
+        int packetPass = (int)(items[i].key >> 62);
+        if (packetPass != pass) {
+            if (countSamples && pass >= 0)
+                glEndQuery(GL_SAMPLES_PASSED);
+            pass = packetPass;
+            if (countSamples) {
+                glBeginQuery(GL_SAMPLES_PASSED, queries[queryFrame][pass]);
+                queryPending[queryFrame][pass] = true;
+            }
+            // the depth pass writes nothing but depth, the opaque pass writes colour again
+            GLboolean writeColor = pass == PASS_DEPTH ? GL_FALSE : GL_TRUE;
+            glColorMask(writeColor, writeColor, writeColor, writeColor);
+        }
+        // the pre-pass already holds the nearest depth, only the surface that wrote it passes GL_EQUAL
+        if (packet.prepassed != equalDepth) {
+            equalDepth = packet.prepassed;
+            glDepthFunc(equalDepth ? GL_EQUAL : GL_LESS);
+            glDepthMask(equalDepth ? GL_FALSE : GL_TRUE);
+        }
+
+        // redundant changes between neighbouring packets are dropped by GLState
+        packet.shader->use();
+        GLState::polygonMode(packet.polygonMode);
+        if (packet.texture != 0) {
+            GLState::activeTexture(GL_TEXTURE0);
+            GLState::bindTexture(GL_TEXTURE_2D_ARRAY, packet.texture);
+        }
+        glBindBufferRange(GL_UNIFORM_BUFFER, OBJECT_BLOCK_BINDING, ring.ID, packet.object, sizeof(ObjectBlock));
+        if (packet.mesh != NULL)
+            packet.mesh->setMaterialUniforms(*packet.shader);
+
+        GLState::bindVertexArray(packet.VAO);
+        glDrawElements(GL_TRIANGLES, packet.indexCount, GL_UNSIGNED_INT, 0);
+        indexCount += packet.indexCount;
+    }
+
+    if (countSamples) {
+        glEndQuery(GL_SAMPLES_PASSED);
+        // a pass without packets this frame counts zero samples rather than keeping an old result
+        for (unsigned int p = 0; p < PASS_COUNT; p++)
+            if (!queryPending[queryFrame][p]) {
+                glBeginQuery(GL_SAMPLES_PASSED, queries[queryFrame][p]);
+                glEndQuery(GL_SAMPLES_PASSED);
+                queryPending[queryFrame][p] = true;
+            }
+        queryFrame = (queryFrame + 1) % QUERY_FRAMES;
+    }
+    if (equalDepth) {
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+    }
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+void RenderQueue::collectSamples() {
+    // the oldest frames first, so the newest finished result is the one that is kept; the query objects of
+    // this frame are reused below, their results must not be lost even if the GPU is still behind
+    for (unsigned int age = 0; age < QUERY_FRAMES; age++) {
+        unsigned int frame = (queryFrame + age) % QUERY_FRAMES;
+        for (unsigned int p = 0; p < PASS_COUNT; p++) {
+            if (!queryPending[frame][p])
+                continue;
+            GLuint available = GL_TRUE;
+            if (frame != queryFrame)
+                glGetQueryObjectuiv(queries[frame][p], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                glGetQueryObjectuiv(queries[frame][p], GL_QUERY_RESULT, &samples[p]);
+                queryPending[frame][p] = false;
+            }
+        }
+    }
+}
+
+unsigned int RenderQueue::size() const {
+    return (unsigned int)packets.size();
+}
@@ -0,0 +1,129 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <vector>
+#include <stdint.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <learnopengl/shader_variants.h>
+
+#include "RingBuffer.h"
+
+class Mesh;
+class Model;
+class HiZCuller;
+
+
+// Collects the draws of a frame as packets with a 64-bit sort key, radix-sorts them and submits them in an
+// order that minimizes state changes. Key layout, from the most significant bit:
+//   pass (2) | program (10) | texture (12) | depth (24) | vertex array (16)
+// program and texture are small indices assigned per Shader and per texture the first time they are queued, never
+// GL names, which grow with every shader reload.
+// Opaque packets of the same program and texture are thus drawn front-to-back, so early-Z rejects the hidden ones.
+// With a depth pre-pass every model mesh is also queued in the depth pass, which writes only depth through the
+// mesh's position-only VAO; the opaque pass then shades those meshes with GL_EQUAL, so each pixel runs the face
+// shader once however many surfaces cover it. Occlusion queries count the samples of both passes.
+// With an occlusion culler set, model meshes whose bounding box it finds hidden are not queued at all.
+class RenderQueue {
+
+    struct DrawPacket {
+        uint64_t key;
+        Shader* shader;
+        Mesh* mesh;             // null for raw vertex arrays
+        unsigned int VAO;
+        GLsizei indexCount;
+        GLenum polygonMode;
+        bool prepassed;         // depth already written by the pre-pass, tested with GL_EQUAL
+        unsigned int texture;   // GL_TEXTURE_2D_ARRAY bound to unit 0, 0 for none
+        glm::mat4 model;
+        glm::mat3 normalMatrix;
+        GLintptr object;        // offset of the packet's Object block in the ring
+    };
+
+    struct SortItem {
+        uint64_t key;
+        unsigned int packet;
+    };
+
+    // per-Shader state resolved the first time it is queued and again after it was rebuilt
+    struct ProgramEntry {
+        Shader* shader;
+        unsigned int program;
+        Uniform<int> textures;
+    };
+
+    public:
+        enum Pass {
+            PASS_DEPTH = 0,
+            PASS_OPAQUE,
+            PASS_COUNT
+        };
+
+    public:
+        RenderQueue();
+        ~RenderQueue();
+        // starts a new frame, depths of the packets are measured along the given view
+        void begin(const glm::mat4& view, float farPlane);
+        // queues a raw indexed vertex array, center is the object space point used for depth sorting
+        void add(Shader& shader, unsigned int VAO, GLsizei indexCount, GLenum polygonMode, const glm::mat4& model, const glm::vec3& center);
+        // queues every mesh of a model; with visible, only the meshes whose byte in it is not 0
+        void add(Shader& shader, Model& object, const glm::mat4& model, const unsigned char* visible = NULL);
+        // queues every mesh of a model with the variant specialized to its material
+        void add(ShaderVariants& variants, Model& object, const glm::mat4& model, const unsigned char* visible = NULL);
+        // orders the queued packets by their keys
+        void sort();
+        // writes the Object block of every packet into the ring, then issues the sorted packets
+        void submit(RingBuffer& ring);
+
+        // draws model meshes queued from now on into a depth pre-pass with depthShader first, null turns it off
+        void setDepthPrepass(Shader* depthShader);
+        bool hasDepthPrepass() const;
+        // counts the samples passing the depth test in each pass with occlusion queries
+        void setCountSamples(bool count);
+        // samples of a pass in the most recent frame whose queries have completed, results lag a few frames
+        GLuint getSamples(Pass pass) const;
+        // frames after which getSamples() only reports frames queued since then
+        static unsigned int getSampleLatency();
+        // tests model meshes queued from now on against culler and drops the hidden ones, null turns it off
+        void setOcclusionCuller(const HiZCuller* culler);
+        // model meshes queued and dropped as occluded since begin()
+        unsigned int getMeshCount() const;
+        unsigned int getCulledCount() const;
+        // indices drawn by submit() since begin(), over all passes
+        unsigned long long getIndexCount() const;
+
+        unsigned int size() const;
+
+    private:
+        std::vector<DrawPacket> packets;
+        std::vector<SortItem> items;
+        std::vector<SortItem> scratch;
+        std::vector<ProgramEntry> programs;
+        std::vector<unsigned int> textures;
+        glm::mat4 view;
+        float farPlane;
+        Shader* depthShader;
+        const HiZCuller* culler;
+        unsigned int meshCount;
+        unsigned int culledCount;
+        unsigned long long indexCount;
+
+        static const unsigned int QUERY_FRAMES = 4;
+        bool countSamples;
+        unsigned int queries[QUERY_FRAMES][PASS_COUNT];
+        bool queryPending[QUERY_FRAMES][PASS_COUNT];
+        unsigned int queryFrame;
+        GLuint samples[PASS_COUNT];
+
+        unsigned int programIndex(Shader& shader);
+        unsigned int textureIndex(unsigned int texture);
+        uint64_t makeKey(Pass pass, unsigned int program, unsigned int texture, float depth, unsigned int VAO) const;
+        void push(Pass pass, Shader& shader, Mesh* mesh, unsigned int VAO, GLsizei indexCount, GLenum polygonMode, unsigned int texture,
+                  const glm::mat4& model, const glm::mat3& normalMatrix, const glm::vec3& center);
+        void pushMesh(Shader& shader, Mesh& mesh, unsigned int texture, const glm::mat4& model, const glm::mat3& normalMatrix);
+        void collectSamples();
+};
+
+
+#endif
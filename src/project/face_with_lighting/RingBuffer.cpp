@@ -0,0 +1,135 @@
+#include "RingBuffer.h"
+
+#include <algorithm>
+#include <iostream>
+
+
+RingBuffer::RingBuffer(GLsizeiptr frameSize, unsigned int frames)
+    : frameSize(frameSize), frames(frames), current(0), head(0), shortfall(0), fences(frames, (GLsync)0)
+{
+    uniformAlignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+    storageAlignment = 256;
+    if (GLAD_GL_VERSION_4_3)
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+    createStorage();
+}
+
+RingBuffer::~RingBuffer() {
+    deleteStorage();
+}
+
+void RingBuffer::createStorage() {
+    // bound to the copy target only, so no binding the draws depend on is disturbed
+    GLsizeiptr size = frameSize * frames;
+    glGenBuffers(1, &ID);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ID);
+    persistent = GLAD_GL_VERSION_4_4 != 0;
+    if (persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, size, NULL, flags);
+        mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+        if (mapped == NULL) {
+            std::cout << "ERROR::RING_BUFFER::PERSISTENT_MAPPING_FAILED, falling back to glBufferSubData" << std::endl;
+            glDeleteBuffers(1, &ID);
+            glGenBuffers(1, &ID);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, ID);
+            persistent = false;
+        }
+    }
+    if (!persistent) {
+        glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+        staging.resize(size);
+        mapped = &staging[0];
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void RingBuffer::deleteStorage() {
+    for (unsigned int i = 0; i < frames; i++)
+        if (fences[i]) {
+            glDeleteSync(fences[i]);
+            fences[i] = 0;
+        }
+    if (persistent) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, ID);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &ID);
+}
+
+void RingBuffer::beginFrame() {
+    // the last frame did not fit: the regions grow to hold it, at least doubling so that a steadily growing
+    // scene does not reallocate every frame. Every frame in flight has to be done with the old buffer first.
+    if (shortfall > 0) {
+        GLsizeiptr needed = head + shortfall;
+        // allocations are aligned within their region, so every region has to start at a multiple of the alignments
+        GLsizeiptr alignment = std::max(uniformAlignment, storageAlignment);
+        frameSize = (std::max(frameSize * 2, needed) + alignment - 1) / alignment * alignment;
+        std::cout << "ring buffer regions grow to " << frameSize << " bytes per frame" << std::endl;
+        for (unsigned int i = 0; i < frames; i++)
+            if (fences[i])
+                glClientWaitSync(fences[i], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        deleteStorage();
+        createStorage();
+        shortfall = 0;
+    }
+
+    current = (current + 1) % frames;
+    head = 0;
+    if (fences[current]) {
+        // only blocks when the CPU is a full ring of frames ahead of the GPU
+        GLenum status = glClientWaitSync(fences[current], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (status == GL_TIMEOUT_EXPIRED)
+            status = glClientWaitSync(fences[current], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        glDeleteSync(fences[current]);
+        fences[current] = 0;
+    }
+}
+
+void RingBuffer::endFrame() {
+    fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+GLintptr RingBuffer::allocate(GLsizeiptr size, GLsizeiptr alignment, void** data) {
+    GLsizeiptr start = (head + alignment - 1) / alignment * alignment;
+    if (start + size > frameSize) {
+        if (shortfall == 0)
+            std::cout << "ERROR::RING_BUFFER::FRAME_REGION_EXHAUSTED (" << frameSize << " bytes per frame), growing it for the next frame" << std::endl;
+        // what this frame would have needed on top, the next beginFrame() makes room for it
+        shortfall += size + alignment;
+        *data = NULL;
+        return -1;
+    }
+    head = start + size;
+    GLintptr offset = current * frameSize + start;
+    *data = mapped + offset;
+    return offset;
+}
+
+GLsizeiptr RingBuffer::getAvailable(GLsizeiptr alignment) const {
+    GLsizeiptr start = (head + alignment - 1) / alignment * alignment;
+    return start < frameSize ? frameSize - start : 0;
+}
+
+void RingBuffer::flush(GLintptr offset, GLsizeiptr size) {
+    // coherent persistent mappings need no flush
+    if (persistent || size == 0)
+        return;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ID);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, mapped + offset);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+bool RingBuffer::isPersistent() const {
+    return persistent;
+}
+
+GLsizeiptr RingBuffer::getUniformAlignment() const {
+    return uniformAlignment;
+}
+
+GLsizeiptr RingBuffer::getStorageAlignment() const {
+    return storageAlignment;
+}
@@ -0,0 +1,71 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <vector>
+#include <cstring>
+#include <glad/glad.h>
+
+
+// Allocator for per-frame dynamic data (uniform blocks, per-draw data, indirect commands). One buffer is split into
+// one region per frame in flight; each frame writes linearly into its own region, and a fence guards the region
+// until the GPU is done reading it, so uploads never wait on the driver or on the draws of the previous frames.
+// With OpenGL 4.4 the buffer is persistently and coherently mapped (GL_MAP_PERSISTENT_BIT), so writes go
+// straight into GPU visible memory. Older contexts write into a CPU copy that flush() uploads with glBufferSubData.
+// A frame that asks for more than its region holds gets -1 from allocate(); the next beginFrame() then reallocates
+// the buffer with regions large enough for it, so ID changes and everything must be bound again every frame.
+class RingBuffer {
+
+    public:
+        unsigned int ID;
+
+    public:
+        RingBuffer(GLsizeiptr frameSize, unsigned int frames = 3);
+        ~RingBuffer();
+        // moves on to the next region, waiting for the GPU if it is still reading it
+        void beginFrame();
+        // fences the region written during this frame
+        void endFrame();
+        // reserves size bytes in the current region at the given alignment and returns their offset in the buffer,
+        // or -1 if the region is full. data receives the address to write them to.
+        GLintptr allocate(GLsizeiptr size, GLsizeiptr alignment, void** data);
+        // bytes still free in the current region at the given alignment
+        GLsizeiptr getAvailable(GLsizeiptr alignment) const;
+        // makes written bytes visible to the GPU, must be called before the draws that read them
+        void flush(GLintptr offset, GLsizeiptr size);
+
+        // copies a value into the ring and flushes it, returns its offset or -1
+        template <typename T>
+        GLintptr write(const T& value, GLsizeiptr alignment) {
+            void* data;
+            GLintptr offset = allocate(sizeof(T), alignment, &data);
+            if (offset >= 0) {
+                std::memcpy(data, &value, sizeof(T));
+                flush(offset, sizeof(T));
+            }
+            return offset;
+        }
+
+        bool isPersistent() const;
+        // offset alignments the driver requires for glBindBufferRange
+        GLsizeiptr getUniformAlignment() const;
+        GLsizeiptr getStorageAlignment() const;
+
+    private:
+        GLsizeiptr frameSize;
+        unsigned int frames;
+        unsigned int current;
+        GLsizeiptr head;            // next free byte in the current region
+        bool persistent;
+        GLsizeiptr shortfall;       // bytes the current frame asked for beyond its region
+        unsigned char* mapped;      // persistent mapping, or the CPU copy without it
+        std::vector<unsigned char> staging;
+        std::vector<GLsync> fences;
+        GLint uniformAlignment;
+        GLint storageAlignment;
+
+        void createStorage();
+        void deleteStorage();
+};
+
+
+#endif
@@ -0,0 +1,76 @@
+#include "SceneUniforms.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+
+float computeLightRadius(const LightData& light) {
+    float brightest = 0.0f;
+    for (int i = 0; i < 3; i++)
+        brightest = std::max(brightest, light.ambient[i] + light.diffuse[i] + light.specular[i]);
+    // solve constant + linear * d + quadratic * d^2 = brightest / (5 / 256) for d
+    float c = light.constant - brightest * 256.0f / 5.0f;
+    if (c >= 0.0f)
+        return 0.0f;
+    if (light.quadratic <= 0.0f)
+        return light.linear > 0.0f ? -c / light.linear : 1.0e6f;
+    return (-light.linear + std::sqrt(light.linear * light.linear - 4.0f * light.quadratic * c)) / (2.0f * light.quadratic);
+}
+
+glm::mat3 computeNormalMatrix(const glm::mat4& model) {
+    return glm::transpose(glm::inverse(glm::mat3(model)));
+}
+
+void packNormalMatrix(const glm::mat3& normalMatrix, glm::vec4 columns[3]) {
+    for (int i = 0; i < 3; i++)
+        columns[i] = glm::vec4(normalMatrix[i], 0.0f);
+}
+
+SceneUniforms::SceneUniforms(bool lightStorage) : lightStorage(lightStorage)
+{
+    std::memset(&camera, 0, sizeof(camera));
+}
+
+bool SceneUniforms::isLightStorageSupported() {
+    return GLAD_GL_VERSION_4_3 != 0;
+}
+
+bool SceneUniforms::hasLightStorage() const {
+    return lightStorage;
+}
+
+void SceneUniforms::bindBlocks(const Shader& shader) const {
+    shader.bindUniformBlock("Camera", CAMERA_BLOCK_BINDING);
+    if (lightStorage)
+        shader.bindStorageBlock("Lights", LIGHTS_STORAGE_BINDING);
+    else
+        shader.bindUniformBlock("Lights", LIGHTS_BLOCK_BINDING);
+    shader.bindUniformBlock("Object", OBJECT_BLOCK_BINDING);
+}
+
+void SceneUniforms::upload(RingBuffer& ring) {
+    GLintptr cameraOffset = ring.write(camera, ring.getUniformAlignment());
+    if (cameraOffset >= 0)
+        glBindBufferRange(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, ring.ID, cameraOffset, sizeof(CameraBlock));
+
+    // the uniform block is always bound whole, the storage block as long as the list, with at least one element
+    int count = lightStorage ? (int)lights.size() : std::min((int)lights.size(), MAX_LIGHTS);
+    GLsizeiptr size = sizeof(LightsHeader) + (lightStorage ? std::max(count, 1) : MAX_LIGHTS) * sizeof(LightData);
+    unsigned char* data;
+    GLsizeiptr alignment = lightStorage ? ring.getStorageAlignment() : ring.getUniformAlignment();
+    GLintptr lightsOffset = ring.allocate(size, alignment, (void**)&data);
+    if (lightsOffset < 0)
+        return;
+    LightsHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.count = count;
+    std::memcpy(data, &header, sizeof(header));
+    if (count > 0)
+        std::memcpy(data + sizeof(header), &lights[0], count * sizeof(LightData));
+    ring.flush(lightsOffset, size);
+    if (lightStorage)
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, LIGHTS_STORAGE_BINDING, ring.ID, lightsOffset, size);
+    else
+        glBindBufferRange(GL_UNIFORM_BUFFER, LIGHTS_BLOCK_BINDING, ring.ID, lightsOffset, size);
+}
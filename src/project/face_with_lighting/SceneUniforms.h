@@ -0,0 +1,90 @@
+#ifndef SCENE_UNIFORMS_H
+#define SCENE_UNIFORMS_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+
+#include "RingBuffer.h"
+
+// binding points of the uniform blocks shared by all shader programs
+const unsigned int CAMERA_BLOCK_BINDING = 0;
+const unsigned int LIGHTS_BLOCK_BINDING = 1;
+const unsigned int OBJECT_BLOCK_BINDING = 2;
+// storage buffer binding of the Lights block in programs compiled with LIGHT_STORAGE, after ClusteredLighting's
+const unsigned int LIGHTS_STORAGE_BINDING = 3;
+
+// lights the Lights uniform block holds, must match MAX_LIGHTS in lighting.glsl; as a storage block it holds any
+// number
+const int MAX_LIGHTS = 128;
+
+// std140 layout of the Camera block
+struct CameraBlock {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec4 viewPos;      // xyz used
+    glm::mat4 inverseViewProjection;
+};
+
+// std140 and std430 layout of one element of Lights.lights
+struct LightData {
+    glm::vec4 position;     // xyz used
+    glm::vec4 ambient;
+    glm::vec4 diffuse;
+    glm::vec4 specular;
+    float constant;
+    float linear;
+    float quadratic;
+    float radius;           // see computeLightRadius
+};
+
+// std140 and std430 layout of the start of the Lights block, the LightData array follows it
+struct LightsHeader {
+    int count;
+    int padding[3];
+};
+
+// std140 layout of the Object block, the per-draw data of the forward shaders
+struct ObjectBlock {
+    glm::mat4 model;
+    glm::vec4 normalMatrix[3];  // mat3, every column padded to a vec4
+};
+
+// distance at which the light's contribution drops below 5/256 of its brightest color channel, beyond it the
+// light is treated as black. The deferred renderer sizes light volumes with it.
+float computeLightRadius(const LightData& light);
+
+// the matrix that takes object space normals to world space, computed once per object instead of per vertex
+glm::mat3 computeNormalMatrix(const glm::mat4& model);
+// writes a mat3 with the column padding that std140 and std430 use
+void packNormalMatrix(const glm::mat3& normalMatrix, glm::vec4 columns[3]);
+
+
+// per-frame camera and per-scene light data that every program reads from the same uniform blocks. The lights go
+// into a uniform block of MAX_LIGHTS entries, or with light storage into a storage buffer as long as the list, which
+// the programs have to be compiled with LIGHT_STORAGE for.
+class SceneUniforms {
+
+    public:
+        CameraBlock camera;
+        std::vector<LightData> lights;
+
+    public:
+        // lightStorage: the Lights block is a storage buffer, needs OpenGL 4.3
+        SceneUniforms(bool lightStorage = false);
+        // whether the current context has storage buffers for the lights
+        static bool isLightStorageSupported();
+        bool hasLightStorage() const;
+        // connects the Camera, Lights and Object blocks of a program to their binding points
+        void bindBlocks(const Shader& shader) const;
+        // writes the camera and the lights into this frame's region of the ring and binds them there; without light
+        // storage only the first MAX_LIGHTS lights are written
+        void upload(RingBuffer& ring);
+
+    private:
+        bool lightStorage;
+};
+
+
+#endif
@@ -0,0 +1,208 @@
+#include "ShaderReloader.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// seconds between two looks at the modification times when inotify is not available
+const double POLL_INTERVAL = 0.5;
+
+
+static double secondsNow() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// replaces to with the contents of from
+static bool copyFile(const std::string& from, const std::string& to) {
+    std::ifstream in(from.c_str(), std::ios::binary);
+    if (!in)
+        return false;
+    std::ofstream out(to.c_str(), std::ios::binary | std::ios::trunc);
+    out << in.rdbuf();
+    return (bool)out;
+}
+
+// directory part of a source path including the trailing slash, the same form Shader::preprocess resolves includes with
+static std::string directoryOf(const std::string& file) {
+    size_t slash = file.find_last_of("/\\");
+    return slash == std::string::npos ? std::string() : file.substr(0, slash + 1);
+}
+
+ShaderReloader::ShaderReloader(const std::string& sourceDirectory)
+    : sourceDirectory(sourceDirectory), inotifyFd(-1), lastPoll(0.0)
+{
+#ifdef __linux__
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0)
+        std::cout << "ERROR::SHADER_RELOADER::INOTIFY_UNAVAILABLE, polling modification times instead" << std::endl;
+#endif
+}
+
+ShaderReloader::~ShaderReloader() {
+#ifdef __linux__
+    if (inotifyFd >= 0)
+        close(inotifyFd);
+#endif
+}
+
+void ShaderReloader::watch(Shader& shader, const std::function<void(Shader&)>& onReload) {
+    add(shader, onReload);
+}
+
+void ShaderReloader::watch(ShaderVariants& variants) {
+    WatchedVariants watched;
+    watched.variants = &variants;
+    watched.builtCount = 0;
+    addVariants(watched);
+    this->variants.push_back(watched);
+}
+
+void ShaderReloader::update() {
+    // variants built since the last frame join the list
+    for (unsigned int i = 0; i < variants.size(); i++)
+        if (variants[i].variants->getBuiltCount() != variants[i].builtCount)
+            addVariants(variants[i]);
+
+    // start a rebuild of every shader that uses a changed file
+    std::set<std::string> changed = changedFiles();
+    if (!changed.empty()) {
+        for (unsigned int i = 0; i < shaders.size(); i++) {
+            const std::vector<std::string>& files = shaders[i].shader->getSourceFiles();
+            for (unsigned int f = 0; f < files.size(); f++) {
+                if (changed.count(files[f]) == 0)
+                    continue;
+                bool pending = shaders[i].shader->isReloading();
+                std::cout << files[f] << " changed, rebuilding the program of " << files[0] << std::endl;
+                shaders[i].shader->reload();
+                if (!pending)
+                    rebuilding.push_back(i);
+                break;
+            }
+        }
+    }
+
+    // swap in the programs the driver is done with
+    for (unsigned int i = 0; i < rebuilding.size();) {
+        WatchedShader& watched = shaders[rebuilding[i]];
+        Shader& shader = *watched.shader;
+        if (shader.pollReload()) {
+            if (watched.onReload)
+                watched.onReload(shader);
+            // the new version may include files the old one did not
+            watchFiles(shader);
+            std::cout << "Reloaded the program of " << shader.getSourceFiles()[0] << std::endl;
+        }
+        if (shader.isReloading())
+            i++;
+        else
+            rebuilding.erase(rebuilding.begin() + i);
+    }
+}
+
+void ShaderReloader::add(Shader& shader, const std::function<void(Shader&)>& onReload) {
+    if (!known.insert(&shader).second)
+        return;
+    WatchedShader watched;
+    watched.shader = &shader;
+    watched.onReload = onReload;
+    shaders.push_back(watched);
+    watchFiles(shader);
+}
+
+void ShaderReloader::addVariants(WatchedVariants& watched) {
+    ShaderVariants* owner = watched.variants;
+    std::function<void(Shader&)> initialize = [owner](Shader& shader) { owner->initialize(shader); };
+    std::vector<Shader*> built = owner->getVariants();
+    for (unsigned int v = 0; v < built.size(); v++)
+        add(*built[v], initialize);
+    watched.builtCount = owner->getBuiltCount();
+}
+
+std::string ShaderReloader::sourceOf(const std::string& file) const {
+    // only relative paths were copied next to the executable
+    if (sourceDirectory.empty() || file.empty() || file[0] == '/' || file.find(':') != std::string::npos)
+        return file;
+    std::string source = sourceDirectory + file;
+    struct stat info;
+    return stat(source.c_str(), &info) == 0 ? source : file;
+}
+
+void ShaderReloader::watchFiles(const Shader& shader) {
+    const std::vector<std::string>& files = shader.getSourceFiles();
+    for (unsigned int f = 0; f < files.size(); f++) {
+        std::string source = sourceOf(files[f]);
+        if (!watchedFiles.insert(std::make_pair(source, files[f])).second)
+            continue;
+        struct stat info;
+        if (stat(source.c_str(), &info) == 0)
+            modificationTimes[source] = info.st_mtime;
+        if (inotifyFd < 0)
+            continue;
+#ifdef __linux__
+        std::string directory = directoryOf(source);
+        if (!watchedDirectories.insert(directory).second)
+            continue;
+        // editors either rewrite a file in place or write a new one and rename it over the old
+        int wd = inotify_add_watch(inotifyFd, directory.empty() ? "." : directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (wd >= 0)
+            watchDescriptors[wd] = directory;
+        else
+            std::cout << "ERROR::SHADER_RELOADER::CANNOT_WATCH: " << directory << std::endl;
+#endif
+    }
+}
+
+std::set<std::string> ShaderReloader::changedFiles() {
+    std::set<std::string> sources;
+#ifdef __linux__
+    if (inotifyFd >= 0) {
+        char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        ssize_t length;
+        while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+            for (char* p = buffer; p < buffer + length; p += sizeof(struct inotify_event) + ((struct inotify_event*)p)->len) {
+                const struct inotify_event* event = (const struct inotify_event*)p;
+                if (event->len > 0)
+                    sources.insert(watchDescriptors[event->wd] + event->name);
+            }
+        }
+    }
+    else
+#endif
+    {
+        double now = secondsNow();
+        if (now - lastPoll < POLL_INTERVAL)
+            return sources;
+        lastPoll = now;
+        for (std::map<std::string, std::string>::const_iterator it = watchedFiles.begin(); it != watchedFiles.end(); ++it) {
+            struct stat info;
+            if (stat(it->first.c_str(), &info) != 0)
+                continue;
+            time_t& seen = modificationTimes[it->first];
+            if (seen != info.st_mtime) {
+                seen = info.st_mtime;
+                sources.insert(it->first);
+            }
+        }
+    }
+
+    // the program reads its copies, which are brought up to date before rebuilding; the shaders know files by
+    // the paths they read
+    std::set<std::string> changed;
+    for (std::set<std::string>::const_iterator it = sources.begin(); it != sources.end(); ++it) {
+        std::map<std::string, std::string>::const_iterator watched = watchedFiles.find(*it);
+        if (watched == watchedFiles.end())
+            continue;
+        if (watched->first != watched->second && !copyFile(watched->first, watched->second)) {
+            std::cout << "ERROR::SHADER_RELOADER::CANNOT_COPY: " << watched->first << " to " << watched->second << std::endl;
+            continue;
+        }
+        changed.insert(watched->second);
+    }
+    return changed;
+}
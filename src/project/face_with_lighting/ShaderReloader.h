@@ -0,0 +1,69 @@
+#ifndef SHADER_RELOADER_H
+#define SHADER_RELOADER_H
+
+#include <ctime>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <learnopengl/shader.h>
+#include <learnopengl/shader_variants.h>
+
+
+// Rebuilds shaders while the program runs whenever one of their source files, includes too, is saved.
+// On Linux the directories of the sources are watched with inotify, elsewhere their modification times are
+// polled twice a second. A rebuild runs next to the render loop (on the driver's threads if it supports
+// GL_KHR_parallel_shader_compile) and the new program only replaces the old one once it linked, so a typo
+// just prints the compile errors and leaves the last working program in place.
+// The program reads the copies of its shaders next to the executable. When the source directory they were copied
+// from is given, the reloader watches the originals there instead, and copies a changed file over its copy before
+// rebuilding, so the files one actually edits are the ones that count.
+class ShaderReloader {
+
+    struct WatchedShader {
+        Shader* shader;
+        std::function<void(Shader&)> onReload;
+    };
+
+    struct WatchedVariants {
+        ShaderVariants* variants;
+        unsigned int builtCount;        // of variants when its programs were last added to the list
+    };
+
+    public:
+        // sourceDirectory: where the relative shader paths were copied from, with a trailing slash; empty watches
+        // the files the program reads
+        ShaderReloader(const std::string& sourceDirectory = std::string());
+        ~ShaderReloader();
+        // watches a single program; onReload runs after each successful rebuild, to restore uniforms and block bindings
+        void watch(Shader& shader, const std::function<void(Shader&)>& onReload = std::function<void(Shader&)>());
+        // watches every variant, including the ones built later, and runs the variants' initializer after a rebuild
+        void watch(ShaderVariants& variants);
+        // starts rebuilds for changed files and swaps in the finished ones, call once per frame
+        void update();
+
+    private:
+        std::string sourceDirectory;
+        std::vector<WatchedShader> shaders;             // single programs and every built variant, in one list
+        std::vector<WatchedVariants> variants;
+        std::set<Shader*> known;
+        std::vector<unsigned int> rebuilding;           // into shaders
+
+        int inotifyFd;                                  // -1 when polling modification times
+        std::map<std::string, std::string> watchedFiles;  // file watched -> the file the program reads
+        std::set<std::string> watchedDirectories;
+        std::map<int, std::string> watchDescriptors;    // inotify watch -> directory, in the form the sources use
+        std::map<std::string, time_t> modificationTimes;
+        double lastPoll;
+
+        void add(Shader& shader, const std::function<void(Shader&)>& onReload);
+        void addVariants(WatchedVariants& watched);
+        void watchFiles(const Shader& shader);
+        std::string sourceOf(const std::string& file) const;
+        std::set<std::string> changedFiles();
+};
+
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+
+// Which vector instructions the batched loops may use, decided once for every file that has them.
+// SIMD_USE_SSE is defined wherever SSE is: compilers targeting x86 with SSE enabled, and every 64-bit MSVC build,
+// which has no __SSE__. SIMD_USE_AVX is defined on top of it when AVX is enabled (-mavx, /arch:AVX).
+// Code without either falls back to scalar loops.
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define SIMD_USE_SSE
+#endif
+
+#if defined(SIMD_USE_SSE) && defined(__AVX__)
+#include <immintrin.h>
+#define SIMD_USE_AVX
+#endif
+
+
+#endif
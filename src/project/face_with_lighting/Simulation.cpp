@@ -0,0 +1,158 @@
+#include "Simulation.h"
+
+#include <algorithm>
+#include <cmath>
+
+// how far UP and DOWN move the sphere per tick, and J and H change its speed
+const float SPHERE_RADIUS_STEP = 0.001f;
+const float SPEED_STEP = 0.05f;
+// radians per second the sphere orbits at speed 1
+const double ORBIT_SPEED = 0.0012;
+// a simulation that fell further behind than this skips the missed ticks instead of running them in a burst
+const std::chrono::milliseconds MAX_CATCH_UP(250);
+
+
+Camera SimulationState::getCamera() const {
+    Camera camera(cameraPosition, glm::vec3(0.0f, 1.0f, 0.0f), cameraYaw, cameraPitch);
+    camera.Zoom = cameraZoom;
+    return camera;
+}
+
+glm::vec3 SimulationState::getSpherePosition() const {
+    return glm::vec3(sphereRadius * (float)std::sin(orbitAngle), 0.0f, sphereRadius * (float)std::cos(orbitAngle));
+}
+
+Simulation::Simulation(const Camera& camera, float sphereRadius, float speed, double orbitAngle)
+    : camera(camera), moving(true), speed(speed), quit(false), ticks(0)
+{
+    state.cameraPosition = camera.Position;
+    state.cameraYaw = camera.Yaw;
+    state.cameraPitch = camera.Pitch;
+    state.cameraZoom = camera.Zoom;
+    state.sphereRadius = sphereRadius;
+    state.orbitAngle = orbitAngle;
+    previous = state;
+
+    // until the first tick the state is at rest
+    Snapshot initial;
+    initial.previous = state;
+    initial.current = state;
+    initial.time = Clock::now();
+    for (unsigned int i = 0; i < 2; i++) {
+        snapshots.back() = initial;
+        snapshots.publish();
+    }
+    snapshots.acquire();
+}
+
+Simulation::~Simulation() {
+    quit = true;
+    if (thread.joinable())
+        thread.join();
+}
+
+void Simulation::start() {
+    if (!thread.joinable())
+        thread = std::thread(&Simulation::run, this);
+}
+
+void Simulation::setInput(const SimulationInput& input) {
+    this->input.back() = input;
+    this->input.publish();
+}
+
+SimulationState Simulation::getState() {
+    snapshots.acquire();
+    const Snapshot& snapshot = snapshots.front();
+    // the state is shown one tick late, so there always is a tick on either side to blend between
+    float t = std::chrono::duration<float>(Clock::now() - snapshot.time).count() * TICK_RATE;
+    return interpolate(snapshot.previous, snapshot.current, glm::clamp(t, 0.0f, 1.0f));
+}
+
+SimulationState Simulation::advanceTo(double time) {
+    const double tickLength = 1.0 / TICK_RATE;
+    while ((double)ticks.load() * tickLength < time)
+        tick();
+    // time lies within the last tick, between previous and state
+    double t = 1.0 - ((double)ticks.load() * tickLength - time) / tickLength;
+    return interpolate(previous, state, (float)glm::clamp(t, 0.0, 1.0));
+}
+
+unsigned long long Simulation::getTickCount() const {
+    return ticks.load();
+}
+
+void Simulation::run() {
+    const Clock::duration tickLength = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / TICK_RATE));
+    Clock::time_point next = Clock::now();
+    while (!quit.load()) {
+        tick();
+
+        Snapshot& snapshot = snapshots.back();
+        snapshot.previous = previous;
+        snapshot.current = state;
+        snapshot.time = Clock::now();
+        snapshots.publish();
+
+        next += tickLength;
+        if (next < Clock::now() - MAX_CATCH_UP)
+            next = Clock::now();
+        std::this_thread::sleep_until(next);
+    }
+}
+
+void Simulation::tick() {
+    input.acquire();
+    previous = state;
+    step(input.front());
+    ticks++;
+}
+
+void Simulation::step(const SimulationInput& input) {
+    const float dt = 1.0f / TICK_RATE;
+    if (input.keys & KEY_FORWARD)
+        camera.ProcessKeyboard(FORWARD, dt);
+    if (input.keys & KEY_BACKWARD)
+        camera.ProcessKeyboard(BACKWARD, dt);
+    if (input.keys & KEY_LEFT)
+        camera.ProcessKeyboard(LEFT, dt);
+    if (input.keys & KEY_RIGHT)
+        camera.ProcessKeyboard(RIGHT, dt);
+    // the mouse moved by the difference to the input the last tick had
+    if (input.mouseX != consumed.mouseX || input.mouseY != consumed.mouseY)
+        camera.ProcessMouseMovement((float)(input.mouseX - consumed.mouseX), (float)(input.mouseY - consumed.mouseY));
+    if (input.scroll != consumed.scroll)
+        camera.ProcessMouseScroll((float)(input.scroll - consumed.scroll));
+    consumed = input;
+
+    if (input.keys & KEY_SPHERE_AWAY)
+        state.sphereRadius += SPHERE_RADIUS_STEP;
+    if (input.keys & KEY_SPHERE_CLOSER)
+        state.sphereRadius -= SPHERE_RADIUS_STEP;
+    if (input.keys & KEY_PAUSE)
+        moving = false;
+    if (input.keys & KEY_RESUME)
+        moving = true;
+    if (input.keys & KEY_FASTER)
+        speed += SPEED_STEP;
+    if (input.keys & KEY_SLOWER)
+        speed = std::max(speed - SPEED_STEP, 0.0f);
+    if (moving)
+        state.orbitAngle += ORBIT_SPEED * speed * dt;
+
+    state.cameraPosition = camera.Position;
+    state.cameraYaw = camera.Yaw;
+    state.cameraPitch = camera.Pitch;
+    state.cameraZoom = camera.Zoom;
+}
+
+SimulationState Simulation::interpolate(const SimulationState& a, const SimulationState& b, float t) {
+    SimulationState state;
+    state.cameraPosition = glm::mix(a.cameraPosition, b.cameraPosition, t);
+    state.cameraYaw = glm::mix(a.cameraYaw, b.cameraYaw, t);
+    state.cameraPitch = glm::mix(a.cameraPitch, b.cameraPitch, t);
+    state.cameraZoom = glm::mix(a.cameraZoom, b.cameraZoom, t);
+    state.sphereRadius = glm::mix(a.sphereRadius, b.sphereRadius, t);
+    state.orbitAngle = a.orbitAngle + (b.orbitAngle - a.orbitAngle) * t;
+    return state;
+}
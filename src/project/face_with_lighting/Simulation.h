@@ -0,0 +1,113 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <glm/glm.hpp>
+
+#include <learnopengl/camera.h>
+
+#include "SnapshotBuffer.h"
+
+// keys the simulation reacts to, as bits of SimulationInput::keys
+enum SimulationKey {
+    KEY_FORWARD = 1 << 0,
+    KEY_BACKWARD = 1 << 1,
+    KEY_LEFT = 1 << 2,
+    KEY_RIGHT = 1 << 3,
+    KEY_SPHERE_AWAY = 1 << 4,
+    KEY_SPHERE_CLOSER = 1 << 5,
+    KEY_PAUSE = 1 << 6,
+    KEY_RESUME = 1 << 7,
+    KEY_FASTER = 1 << 8,
+    KEY_SLOWER = 1 << 9
+};
+
+// what the window thread saw of the user, handed to the simulation as a whole
+struct SimulationInput {
+    unsigned int keys;          // SimulationKey bits of the keys held down
+    double mouseX, mouseY;      // mouse movement since the start, in pixels, y up
+    double scroll;              // scroll wheel movement since the start
+
+    SimulationInput() : keys(0), mouseX(0.0), mouseY(0.0), scroll(0.0) {}
+};
+
+// everything the renderer needs of one simulation tick
+struct SimulationState {
+    glm::vec3 cameraPosition;
+    float cameraYaw;
+    float cameraPitch;
+    float cameraZoom;
+    float sphereRadius;         // distance of the sphere from the center of its orbit
+    double orbitAngle;          // radians the sphere has travelled, the other lights move along with it
+
+    // a camera looking like the simulated one
+    Camera getCamera() const;
+    // the sphere's position on its orbit
+    glm::vec3 getSpherePosition() const;
+};
+
+
+// Moves the camera and the lights in fixed steps of 1 / TICK_RATE seconds, whatever the frame rate.
+// Started, it ticks on a thread of its own in real time. The window thread passes the input in with setInput();
+// every tick publishes the state before and after it, and getState() blends the two by how far the current time
+// is into the tick, so motion is smooth at any frame rate. Both directions go through SnapshotBuffers: neither
+// thread ever waits for the other, a slow frame does not slow the simulation down and a late tick does not hold a
+// frame back.
+// Not started, it runs lock-step instead: advanceTo() runs the ticks up to a point in simulated time on the
+// calling thread. Driving that with the frame number, frame N shows the same state on every machine.
+class Simulation {
+
+    public:
+        static const unsigned int TICK_RATE = 120;
+
+    public:
+        // orbitAngle: where on its orbit the sphere starts
+        Simulation(const Camera& camera, float sphereRadius, float speed, double orbitAngle = 0.0);
+        ~Simulation();
+        // starts ticking in real time on the simulation thread
+        void start();
+        // lock-step mode: runs the ticks up to time, in seconds since the start, and returns the state at time
+        SimulationState advanceTo(double time);
+        // window thread: the input the next ticks work with
+        void setInput(const SimulationInput& input);
+        // window thread: the state at the current time, interpolated between the last two ticks
+        SimulationState getState();
+
+        // ticks run so far
+        unsigned long long getTickCount() const;
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        // the two states around the latest tick
+        struct Snapshot {
+            SimulationState previous;
+            SimulationState current;
+            Clock::time_point time;     // when the current state was published
+        };
+
+        // simulation thread only
+        Camera camera;
+        SimulationState state;
+        SimulationState previous;       // the state before the last tick
+        bool moving;
+        float speed;
+        SimulationInput consumed;       // the input up to which mouse and scroll movement was applied
+
+        SnapshotBuffer<SimulationInput> input;
+        SnapshotBuffer<Snapshot> snapshots;
+        std::thread thread;
+        std::atomic<bool> quit;
+        std::atomic<unsigned long long> ticks;
+
+        void run();
+        // advances the state by one tick with the latest input
+        void tick();
+        void step(const SimulationInput& input);
+        static SimulationState interpolate(const SimulationState& a, const SimulationState& b, float t);
+};
+
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef SNAPSHOT_BUFFER_H
+#define SNAPSHOT_BUFFER_H
+
+#include <atomic>
+
+
+// Hands the latest value of something from one thread to another without locks. The writer fills back() and
+// publish()es it; the reader calls acquire() and reads front(), which stays untouched until its next acquire().
+// Three slots make this work without either side ever waiting: one is being written, one is being read, and the
+// one in between holds the newest published value. Values published while the reader was busy replace each
+// other, the reader only ever sees the newest.
+template <typename T>
+class SnapshotBuffer {
+
+    public:
+        SnapshotBuffer(const T& initial = T()) : shared(1), writeIndex(0), readIndex(2) {
+            for (unsigned int i = 0; i < 3; i++)
+                slots[i] = initial;
+        }
+
+        // writer side: the slot to fill, then publish it
+        T& back() {
+            return slots[writeIndex];
+        }
+        void publish() {
+            // the release half makes the slot's contents visible to the reader that takes it
+            writeIndex = shared.exchange(writeIndex | FRESH, std::memory_order_acq_rel) & INDEX;
+        }
+
+        // reader side: takes the newest published value if there is one, returns whether front() changed
+        bool acquire() {
+            if ((shared.load(std::memory_order_relaxed) & FRESH) == 0)
+                return false;
+            readIndex = shared.exchange(readIndex, std::memory_order_acq_rel) & INDEX;
+            return true;
+        }
+        const T& front() const {
+            return slots[readIndex];
+        }
+
+    private:
+        static const unsigned int INDEX = 3;
+        static const unsigned int FRESH = 4;    // the shared slot holds a value the reader has not taken yet
+
+        T slots[3];
+        std::atomic<unsigned int> shared;       // index of the slot in between, and FRESH
+        unsigned int writeIndex;
+        unsigned int readIndex;
+
+        SnapshotBuffer(const SnapshotBuffer&);
+        SnapshotBuffer& operator=(const SnapshotBuffer&);
+};
+
+
+#endif
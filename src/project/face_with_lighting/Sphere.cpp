@@ -57,7 +57,7 @@ Sphere::Sphere(unsigned int xSegments, unsigned int ySegments)
 }
 
 Sphere::~Sphere() {
-    glDeleteVertexArrays(1, &VAO);
+    GLState::deleteVertexArray(VAO);
     glDeleteBuffers(1, &VBO);
 }
 
@@ -67,7 +67,7 @@ void Sphere::setupSphere() {
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
 
-    glBindVertexArray(VAO);
+    GLState::bindVertexArray(VAO);
     // load data into vertex buffers
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     // A great thing about structs is that their memory layout is sequential for all its items.
@@ -89,18 +89,5 @@ void Sphere::setupSphere() {
     glEnableVertexAttribArray(2);
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
 
-    glBindVertexArray(0);
-}
-
-void Sphere::Draw() {
-    // draw
-    glActiveTexture(GL_TEXTURE0);
-    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(Indices.size()), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
-
-    // always good practice to set everything back to defaults once configured.
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-    glActiveTexture(GL_TEXTURE0);
+    GLState::bindVertexArray(0);
 }
\ No newline at end of file
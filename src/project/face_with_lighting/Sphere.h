@@ -19,6 +19,8 @@ class Sphere {
     };
 
     public:
+        // position, normal and texture coordinates from the buffers below, drawn by DeferredRenderer's light
+        // volumes; LightGizmos builds its own instanced vertex array on the same buffers
         unsigned int VAO = 0;
         unsigned int VBO;
         unsigned int EBO;
@@ -30,8 +32,6 @@ class Sphere {
     public:
         Sphere(unsigned int xSegments, unsigned int ySegments);
         ~Sphere();
-        // You must implement these functions!
-        void Draw();
         void setupSphere();
             
 };
@@ -0,0 +1,7 @@
+// camera data shared by all programs, see CameraBlock in SceneUniforms.h
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    mat4 inverseViewProjection;
+};
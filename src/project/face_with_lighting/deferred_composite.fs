@@ -0,0 +1,16 @@
+#version 330 core
+// writes the accumulated light and the scene depth of the deferred renderer into the target framebuffer
+out vec4 FragColor;
+
+uniform sampler2D lightBuffer;
+uniform sampler2D gDepth;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, texel, 0).r;
+    if (depth == 1.0)
+        discard;    // background
+    FragColor = vec4(texelFetch(lightBuffer, texel, 0).rgb, 1.0);
+    gl_FragDepth = depth;
+}
@@ -0,0 +1,39 @@
+#version 330 core
+#ifdef LIGHT_STORAGE
+#extension GL_ARB_shader_storage_buffer_object : require
+#endif
+// lighting pass of the deferred renderer, adds one light to the pixels its volume covers
+out vec4 FragColor;
+
+flat in int LightIndex;
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gSpecular;
+uniform sampler2D gDepth;
+uniform vec2 viewportSize;      // the corner of the G-buffer the frame was drawn in
+
+#include "lighting.glsl"
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, texel, 0).r;
+    if (depth == 1.0)
+        discard;    // background
+
+    // world position from the depth
+    vec2 ndc = gl_FragCoord.xy / viewportSize * 2.0 - 1.0;
+    vec4 world = inverseViewProjection * vec4(ndc, depth * 2.0 - 1.0, 1.0);
+    vec3 fragPos = world.xyz / world.w;
+
+    Light light = lights[LightIndex];
+    if (length(light.position.xyz - fragPos) > light.radius)
+        discard;
+
+    vec4 normalShininess = texelFetch(gNormal, texel, 0);
+    vec3 diffuseColor = texelFetch(gAlbedo, texel, 0).rgb;
+    vec3 specularColor = texelFetch(gSpecular, texel, 0).rgb;
+    vec3 viewDir = normalize(viewPos.xyz - fragPos);
+    FragColor = vec4(shadeLight(light, fragPos, normalize(normalShininess.xyz), viewDir, diffuseColor, specularColor, normalShininess.w), 1.0);
+}
@@ -0,0 +1,21 @@
+#version 330 core
+#ifdef LIGHT_STORAGE
+#extension GL_ARB_shader_storage_buffer_object : require
+#endif
+// one instance per light, a unit sphere scaled to the light's radius
+layout (location = 0) in vec3 aPos;
+
+flat out int LightIndex;
+
+#include "lighting.glsl"
+
+// the sphere mesh is inscribed in the unit sphere, grow it so it covers the whole radius
+const float VOLUME_SCALE = 1.15;
+
+void main()
+{
+    Light light = lights[gl_InstanceID];
+    LightIndex = gl_InstanceID;
+    vec3 worldPos = light.position.xyz + aPos * light.radius * VOLUME_SCALE;
+    gl_Position = projection * view * vec4(worldPos, 1.0);
+}
@@ -0,0 +1,5 @@
+#version 330 core
+// depth pre-pass: no color output, the depth test does all the work
+void main()
+{
+}
@@ -0,0 +1,16 @@
+#version 330 core
+// depth pre-pass: positions only. The position is computed exactly like in face_shader.vs and both are invariant,
+// so the shading pass reproduces the same depths and can test them with GL_EQUAL.
+layout (location = 0) in vec3 aPos;
+
+invariant gl_Position;
+
+#include "camera.glsl"
+
+#include "object.glsl"
+
+void main()
+{
+    vec3 FragPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(FragPos, 1.0); 
+}
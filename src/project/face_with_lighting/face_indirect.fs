@@ -0,0 +1,30 @@
+#version 430 core
+out vec4 FragColor;
+
+struct Material {
+    sampler2DArray textures;    // all textures of the model, one per layer
+    float shininess;
+}; 
+
+in vec3 FragPos;  
+in vec3 Normal;  
+in vec2 TexCoords;
+flat in ivec2 Layers;   // x: diffuse layer, y: specular layer of the draw, -1 if it has no such map
+flat in vec3 DiffuseColor;
+
+#include "lighting.glsl"
+
+uniform Material material;
+
+void main()
+{
+    // one program draws every mesh of the multi-draw, so the maps are selected per draw instead of per variant
+    vec3 diffuseColor = DiffuseColor;
+    if (Layers.x >= 0)
+        diffuseColor *= texture(material.textures, vec3(TexCoords, Layers.x)).rgb;
+    vec3 specularColor = diffuseColor;
+    if (Layers.y >= 0)
+        specularColor = texture(material.textures, vec3(TexCoords, Layers.y)).rgb;
+    vec3 result = shadeLights(FragPos, normalize(Normal), diffuseColor, specularColor, material.shininess);
+    FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,36 @@
+#version 430 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in uint aDrawID;     // per instance, selected by the baseInstance of each indirect command
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+flat out ivec2 Layers;
+flat out vec3 DiffuseColor;
+
+#include "camera.glsl"
+#include "normals.glsl"
+
+struct DrawData {
+    mat4 model;
+    mat3 normalMatrix;
+    vec4 diffuseColor;
+    ivec4 layers;   // x: diffuse layer, y: specular layer, -1 for none
+};
+
+layout (std430, binding = 0) readonly buffer Draws {
+    DrawData draws[];
+};
+
+void main()
+{
+    DrawData draw = draws[aDrawID];
+    FragPos = vec3(draw.model * vec4(aPos, 1.0));
+    Normal = transformNormal(draw.model, draw.normalMatrix, aNormal);  
+    TexCoords = aTexCoords;
+    Layers = draw.layers.xy;
+    DiffuseColor = draw.diffuseColor.rgb;
+    gl_Position = projection * view * vec4(FragPos, 1.0); 
+}
\ No newline at end of file
@@ -1,57 +1,20 @@
 #version 330 core
+#ifdef LIGHT_STORAGE
+#extension GL_ARB_shader_storage_buffer_object : require
+#endif
 out vec4 FragColor;
 
-struct Material {
-    sampler2D diffuse;
-    sampler2D specular;    
-    float shininess;
-}; 
-
-struct Light {
-    vec3 position;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-    float constant;
-    float linear;
-    float quadratic;
-};
-
 in vec3 FragPos;  
 in vec3 Normal;  
 in vec2 TexCoords;
-  
-uniform vec3 viewPos;
-uniform Material material;
-uniform Light light;
-uniform vec3 kd;
+
+#include "material.glsl"
+#include "lighting.glsl"
 
 void main()
 {
-    // ambient
-    vec3 ambient = light.ambient * texture(material.diffuse, TexCoords).rgb;
-  	
-    // diffuse 
-    vec3 norm = normalize(Normal);
-    vec3 lightDir = normalize(light.position - FragPos);
-    float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = light.diffuse * diff * texture(material.diffuse, TexCoords).rgb;  
-    
-    // specular
-    vec3 viewDir = normalize(viewPos - FragPos);
-    vec3 reflectDir = reflect(-lightDir, norm);  
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    vec3 specular = light.specular * spec * texture(material.specular, TexCoords).rgb;  
-
-    // distance
-    float distance    = length(light.position - FragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
-
-    ambient  *= attenuation;  
-    diffuse  *= attenuation;
-    specular *= attenuation;   
-
-    vec3 result = ambient + diffuse +specular;
-    FragColor = vec4(result,1.0)* vec4(kd,1.0);
-}
\ No newline at end of file
+    vec3 diffuseColor = materialDiffuse(TexCoords);
+    vec3 specularColor = materialSpecular(TexCoords, diffuseColor);
+    vec3 result = shadeLights(FragPos, normalize(Normal), diffuseColor, specularColor, material.shininess);
+    FragColor = vec4(result, 1.0);
+}
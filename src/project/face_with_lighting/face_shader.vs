@@ -7,14 +7,17 @@ out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model;
+// matches depth_only.vs bit for bit, for the depth pre-pass
+invariant gl_Position;
+
+#include "camera.glsl"
+
+#include "object.glsl"
 
 void main()
 {
     FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;  
+    Normal = transformNormal(model, normalMatrix, aNormal);  
     TexCoords = aTexCoords;
     gl_Position = projection * view * vec4(FragPos, 1.0); 
 }
\ No newline at end of file
@@ -0,0 +1,19 @@
+#version 330 core
+// geometry pass of the deferred renderer, writes the surface attributes the lighting pass needs
+layout (location = 0) out vec4 gAlbedo;     // rgb: diffuse color
+layout (location = 1) out vec4 gNormal;     // xyz: world space normal, w: shininess
+layout (location = 2) out vec4 gSpecular;   // rgb: specular color
+
+in vec3 FragPos;  
+in vec3 Normal;  
+in vec2 TexCoords;
+
+#include "material.glsl"
+
+void main()
+{
+    vec3 diffuseColor = materialDiffuse(TexCoords);
+    gAlbedo = vec4(diffuseColor, 1.0);
+    gNormal = vec4(normalize(Normal), material.shininess);
+    gSpecular = vec4(materialSpecular(TexCoords, diffuseColor), 1.0);
+}
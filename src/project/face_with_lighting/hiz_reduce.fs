@@ -0,0 +1,19 @@
+#version 330 core
+// base level of the hierarchical-Z pyramid: each texel keeps the farthest depth of a BLOCK x BLOCK block of the
+// scene, so a box behind it is behind everything the block shows
+out float FragDepth;
+
+uniform sampler2D depth;
+uniform ivec2 sourceSize;   // the part of the depth texture the scene was drawn into
+
+const int BLOCK = 8;        // HiZCuller::BLOCK
+
+void main()
+{
+    ivec2 origin = ivec2(gl_FragCoord.xy) * BLOCK;
+    float farthest = 0.0;
+    for (int y = 0; y < BLOCK; y++)
+        for (int x = 0; x < BLOCK; x++)
+            farthest = max(farthest, texelFetch(depth, min(origin + ivec2(x, y), sourceSize - 1), 0).r);
+    FragDepth = farthest;
+}
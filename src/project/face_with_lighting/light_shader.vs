@@ -1,20 +1,15 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
-layout (location = 2) in vec2 aTexCoords;
+// per instance, see LightGizmos: center and radius of the light's sphere, and its colour
+layout (location = 3) in vec4 aPlacement;
+layout (location = 4) in vec4 aColor;
 
-out vec3 FragPos;
-out vec3 Normal;
-out vec2 TexCoords;
+out vec3 Color;
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model;
+#include "camera.glsl"
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;  
-    TexCoords = aTexCoords;
-    gl_Position = projection * view * model * vec4(aPos, 1.0f); 
-}
\ No newline at end of file
+    Color = aColor.rgb;
+    gl_Position = projection * view * vec4(aPlacement.xyz + aPos * aPlacement.w, 1.0);
+}
@@ -0,0 +1,139 @@
+// Phong lighting of the scene lights, shared by the face shaders and the deferred lighting pass.
+// Define NUM_LIGHTS to the number of lights to get a loop with a constant trip count instead of reading lightCount.
+// Define LIGHT_STORAGE to read the lights from a storage buffer of any length instead of a uniform block of
+// MAX_LIGHTS; a #version 330 shader has to enable GL_ARB_shader_storage_buffer_object for it.
+// Define CLUSTERED_LIGHTING, together with LIGHT_STORAGE, to shade only the lights ClusteredLighting binned into the
+// fragment's cluster.
+// Define POINT_SHADOWS to shadow the first light (the sphere) with the cube map of PointShadowMap.
+
+#include "camera.glsl"
+
+#define MAX_LIGHTS 128
+
+struct Light {
+    vec4 position;
+
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+    float constant;
+    float linear;
+    float quadratic;
+    float radius;       // distance at which the light fades out, bounds its volume in the deferred renderer
+};
+
+#ifdef LIGHT_STORAGE
+layout (std430) buffer Lights {
+    int lightCount;
+    Light lights[];
+};
+#else
+layout (std140) uniform Lights {
+    int lightCount;
+    Light lights[MAX_LIGHTS];
+};
+#endif
+
+#ifdef CLUSTERED_LIGHTING
+#ifndef LIGHT_STORAGE
+#error CLUSTERED_LIGHTING bins the lights of the storage buffer, define LIGHT_STORAGE too
+#endif
+// light lists of the clusters the view frustum is divided into, see ClusteredLighting.h
+layout (std430) buffer LightClusters {
+    uvec4 clusterCounts;    // xyz: tiles across, tiles up, depth slices
+    vec4 clusterScale;      // xy: tiles per pixel, z: slices per unit of log view depth, w: log of the near plane
+    uvec2 clusters[];       // x: first entry in lightIndices, y: number of lights
+};
+
+layout (std430) buffer LightIndices {
+    uint lightIndices[];
+};
+
+// the light list of the cluster a fragment falls into
+uvec2 clusterLights(vec3 fragPos)
+{
+    float depth = max(-(view * vec4(fragPos, 1.0)).z, 1e-6);
+    uvec2 tile = min(uvec2(gl_FragCoord.xy * clusterScale.xy), clusterCounts.xy - 1u);
+    uint slice = uint(clamp((log(depth) - clusterScale.w) * clusterScale.z, 0.0, float(clusterCounts.z - 1u)));
+    return clusters[(slice * clusterCounts.y + tile.y) * clusterCounts.x + tile.x];
+}
+#endif
+
+#ifdef POINT_SHADOWS
+// distance from lights[0] to the nearest caster, divided by the light's radius, which is the map's far plane
+uniform samplerCubeShadow shadowMap;
+
+// keeps lit surfaces from shadowing themselves, in world units
+const float SHADOW_BIAS = 0.01;
+
+float pointShadow(Light light, vec3 fragPos)
+{
+    vec3 fromLight = fragPos - light.position.xyz;
+    return texture(shadowMap, vec4(fromLight, (length(fromLight) - SHADOW_BIAS) / light.radius));
+}
+#endif
+
+// how much of the light with the given index reaches a surface point, only the first light casts shadows
+float lightVisibility(int index, vec3 fragPos)
+{
+#ifdef POINT_SHADOWS
+    if (index == 0)
+        return pointShadow(lights[0], fragPos);
+#endif
+    return 1.0;
+}
+
+// contribution of one light to a surface point, visibility scales everything but the ambient term
+vec3 shadeLight(Light light, float visibility, vec3 fragPos, vec3 norm, vec3 viewDir, vec3 diffuseColor, vec3 specularColor, float shininess)
+{
+    // ambient
+    vec3 ambient = light.ambient.rgb * diffuseColor;
+  	
+    // diffuse 
+    vec3 lightDir = normalize(light.position.xyz - fragPos);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuse = light.diffuse.rgb * diff * diffuseColor;  
+    
+    // specular
+    vec3 reflectDir = reflect(-lightDir, norm);  
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    vec3 specular = light.specular.rgb * spec * specularColor;  
+
+    // distance
+    float distance    = length(light.position.xyz - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
+
+    ambient  *= attenuation;  
+    diffuse  *= attenuation;
+    specular *= attenuation;   
+
+    return ambient + visibility * (diffuse + specular);
+}
+
+vec3 shadeLight(Light light, vec3 fragPos, vec3 norm, vec3 viewDir, vec3 diffuseColor, vec3 specularColor, float shininess)
+{
+    return shadeLight(light, 1.0, fragPos, norm, viewDir, diffuseColor, specularColor, shininess);
+}
+
+vec3 shadeLights(vec3 fragPos, vec3 norm, vec3 diffuseColor, vec3 specularColor, float shininess)
+{
+    vec3 viewDir = normalize(viewPos.xyz - fragPos);
+
+    vec3 result = vec3(0.0);
+#if defined(CLUSTERED_LIGHTING)
+    uvec2 list = clusterLights(fragPos);
+    for (uint i = list.x; i < list.x + list.y; i++)
+    {
+        int index = int(lightIndices[i]);
+        result += shadeLight(lights[index], lightVisibility(index, fragPos), fragPos, norm, viewDir, diffuseColor, specularColor, shininess);
+    }
+#else
+#ifdef NUM_LIGHTS
+    for (int i = 0; i < NUM_LIGHTS; i++)
+#else
+    for (int i = 0; i < lightCount; i++)
+#endif
+        result += shadeLight(lights[i], lightVisibility(i, fragPos), fragPos, norm, viewDir, diffuseColor, specularColor, shininess);
+#endif
+    return result;
+}
@@ -8,22 +8,53 @@
 
 #include <learnopengl/filesystem.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/shader_variants.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
 
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
 #include "Sphere.h"
+#include "SceneUniforms.h"
+#include "RenderQueue.h"
+#include "IndirectRenderer.h"
+#include "ShaderReloader.h"
+#include "DeferredRenderer.h"
+#include "ClusteredLighting.h"
+#include "PointShadowMap.h"
+#include "Profiler.h"
+#include "FramePacer.h"
+#include "Simulation.h"
+#include "DynamicResolution.h"
+#include "HiZCuller.h"
+#include "FrustumCuller.h"
+#include "LightGizmos.h"
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
+void printOverdraw(const RenderQueue& queue, bool prepass);
+void parseArguments(int argc, char** argv);
 
 // settings
 const unsigned int SCR_WIDTH = 900;
 const unsigned int SCR_HEIGHT = 600;
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
+const float ORBITING_GIZMO_SCALE = 0.25f;	// size of the orbiting lights' spheres relative to the sphere's
+const GLsizeiptr RING_FRAME_SIZE = 8 * 1024 * 1024;	// bytes of per-frame dynamic data
+const double BENCHMARK_FRAME_TIME = 1.0 / 60.0;		// simulated seconds per frame of a --frames run
 
-// camera
+// camera, where it starts; from there on the simulation moves it
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 float lastX = (float)SCR_WIDTH / 2.0f;
 float lastY = (float)SCR_HEIGHT / 2.0f;
@@ -31,22 +62,59 @@ bool firstMouse = true;
 
 // some variables for control
 GLfloat scale = 0.1f;
-bool sphere_moves = true;
 GLfloat speed = 5.0f;
 float radius = 14.0f * scale;
 
-// timing
-float deltaTime = 0.0f;
-float lastFrame = 0.0f;
-
-int main()
+// the keys and mouse movement of the window, collected for the simulation thread
+SimulationInput input;
+
+// command line options
+bool headless = false;			// --headless: render into a hidden window, for benchmark runs in CI
+unsigned int maxFrames = 0;		// --frames N: exit after N frames and print the average frame time, 0 runs until closed
+unsigned int headCount = 1;		// --heads N: number of heads, laid out on a grid
+bool useIndirect = false;		// --indirect: draw the heads with glMultiDrawElementsIndirect (needs OpenGL 4.3)
+bool legacyNormals = false;		// --legacy-normals: invert the model matrix per vertex, to compare against the CPU normal matrix
+bool useDeferred = false;		// --deferred: shade the heads with the deferred renderer
+bool useClustered = false;		// --clustered: shade the heads with the lights binned into their view frustum cluster
+bool useShadows = true;			// --no-shadows: the sphere's light casts no shadows
+bool layeredShadows = true;		// --six-pass-shadows: render the shadow cube map one face at a time instead of in one layered pass
+unsigned int lightCount = 1;		// --lights N: the sphere's light plus N - 1 coloured lights orbiting the heads
+bool depthPrepass = false;		// --depth-prepass: lay down the depth of the heads first, then shade them with GL_EQUAL; Z toggles it
+std::string tracePath;			// --trace FILE: write the profiler's last frames to FILE as a Chrome trace at exit
+bool traceRequested = false;		// T writes the trace while the program runs
+int swapInterval = 1;			// --swap-interval N: 1 waits for every vertical blank, 0 never, -1 only while on time (adaptive vsync); 0 with --headless
+bool swapIntervalSet = false;
+float targetFps = 0.0f;			// --fps N: cap the frame rate to N, sleeping away the rest of each frame
+unsigned int seed = 1;			// --seed N: lays out the orbiting lights; with --frames, frame N looks the same on every machine
+float resolutionTarget = 0.0f;		// --dynamic-resolution MS: lower the resolution while the GPU takes longer than MS per frame
+float minResolutionScale = 0.5f;	// --min-resolution-scale F: the lowest fraction of the window's resolution it goes down to
+bool frustumCulling = true;		// --no-frustum-culling: draw the meshes outside the view as well
+bool occlusionCulling = false;		// --occlusion-culling: skip the heads' meshes hidden behind the depth of an earlier frame
+bool lowLatency = false;		// --low-latency: poll input after the frame limiter's wait and finish each frame before starting the next
+
+// a light circling the center of the head grid
+struct OrbitingLight {
+	float orbitRadius;
+	float height;
+	float phase;
+	float speed;		// relative to the sphere's, negative ones go the other way round
+};
+
+int main(int argc, char** argv)
 {
+	parseArguments(argc, argv);
+
 	// glfw: initialize and configure
 	// ------------------------------
 	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	// --indirect, --clustered and more lights than the Lights uniform block holds need OpenGL 4.3, which is asked
+	// for explicitly instead of hoping the driver hands out more than 3.3
+	bool needsGL43 = useIndirect || useClustered || lightCount > (unsigned int)MAX_LIGHTS;
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, needsGL43 ? 4 : 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	if (headless)
+		glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
 
 #ifdef __APPLE__
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
@@ -55,6 +123,12 @@ int main()
 	// glfw window creation
 	// --------------------
 	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LightingFace", NULL, NULL);
+	if (window == NULL && needsGL43)
+	{
+		// without 4.3 the options that need it fall back below, the rest runs on 3.3
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LightingFace", NULL, NULL);
+	}
 	if (window == NULL)
 	{
 		std::cout << "Failed to create GLFW window" << std::endl;
@@ -62,12 +136,22 @@ int main()
 		return -1;
 	}
 	glfwMakeContextCurrent(window);
+	// the driver's default swap interval differs between platforms, so it is always set
+	if (!swapIntervalSet && headless)
+		swapInterval = 0;
+	if (swapInterval < 0 && !glfwExtensionSupported("WGL_EXT_swap_control_tear") && !glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+	{
+		std::cout << "adaptive vsync is not supported, waiting for every vertical blank instead" << std::endl;
+		swapInterval = 1;
+	}
+	glfwSwapInterval(swapInterval);
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 	glfwSetCursorPosCallback(window, mouse_callback);
 	glfwSetScrollCallback(window, scroll_callback);
 
 	// tell GLFW to capture our mouse
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	if (!headless)
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
 	// glad: load all OpenGL function pointers
 	// ---------------------------------------
@@ -81,105 +165,556 @@ int main()
 	// -----------------------------
 	glEnable(GL_DEPTH_TEST);
 
+	// CPU and GPU time of the parts of every frame, for the trace written with T or --trace
+	Profiler profiler;
+
 	// build and compile shaders
 	// -------------------------
-	Shader sphereShader("light_shader.vs", "light_shader.fs");	//shader for sphere/lamp
-	Shader faceShader("face_shader.vs", "face_shader.fs");		//shader for face
+	// every program is only submitted here and checked after the model has loaded, so the driver compiles
+	// them (on its own threads, with KHR_parallel_shader_compile) while the textures decode
+	float startupTime = glfwGetTime();
+	ProfileScope startupScope(profiler, "startup");
+	Shader::enableParallelCompile((GLADloadproc)glfwGetProcAddress);
+	std::vector<std::string> defines;
+	if (legacyNormals)
+		defines.push_back("LEGACY_NORMAL_MATRIX");
+	Shader sphereShader("light_shader.vs", "light_shader.fs", nullptr, defines, true);	//shader for sphere/lamp
+
+	// camera and light data shared by both programs through uniform blocks, written with all
+	// other per-frame data into a persistently mapped ring buffer
+	// ---------------------------------------------------------------------------------------
+	RingBuffer ring(RING_FRAME_SIZE);
+	// the spheres are placed by their instance attributes, they only read the Camera block
+	std::function<void(Shader&)> setupSphereShader = [](Shader& shader) {
+		shader.bindUniformBlock("Camera", CAMERA_BLOCK_BINDING);
+	};
+
+	// the indirect path has its own face shader, which reads per-draw data from a storage buffer
+	if (useDeferred && useIndirect)
+	{
+		std::cout << "--deferred draws the heads through the render queue, ignoring --indirect" << std::endl;
+		useIndirect = false;
+	}
+	if (useIndirect && !IndirectRenderer::isSupported())
+	{
+		std::cout << "--indirect needs OpenGL 4.3, falling back to the render queue" << std::endl;
+		useIndirect = false;
+	}
+	// the multi-draw takes whole heads, nothing would read the depth pyramid
+	if (useIndirect && occlusionCulling)
+	{
+		std::cout << "--indirect draws every head in view, ignoring --occlusion-culling" << std::endl;
+		occlusionCulling = false;
+	}
+	// clustered shading only changes how the forward face shaders pick their lights
+	if (useDeferred && useClustered)
+	{
+		std::cout << "--deferred lights every pixel from the G-buffer, ignoring --clustered" << std::endl;
+		useClustered = false;
+	}
+	if (useClustered && !ClusteredLighting::isSupported())
+	{
+		std::cout << "--clustered needs OpenGL 4.3, shading every light per fragment instead" << std::endl;
+		useClustered = false;
+	}
+	// clustered shading and long light lists read the lights from a storage buffer instead of the uniform block
+	if (lightCount > (unsigned int)MAX_LIGHTS && !SceneUniforms::isLightStorageSupported())
+	{
+		std::cout << "more than " << MAX_LIGHTS << " lights need OpenGL 4.3, drawing " << MAX_LIGHTS << std::endl;
+		lightCount = MAX_LIGHTS;
+	}
+	bool lightStorage = useClustered || lightCount > (unsigned int)MAX_LIGHTS;
+	if (lightStorage)
+		defines.push_back("LIGHT_STORAGE");
+	if (useClustered)
+		defines.push_back("CLUSTERED_LIGHTING");
+	SceneUniforms scene(lightStorage);
+	// the sphere's light casts shadows in the forward paths
+	if (useDeferred)
+		useShadows = false;
+	if (useShadows)
+		defines.push_back("POINT_SHADOWS");
+	std::unique_ptr<Shader> faceIndirectShader;
+	if (useIndirect)
+		faceIndirectShader.reset(new Shader("face_indirect.vs", "face_indirect.fs", nullptr, defines, true));
+	std::function<void(Shader&)> setupFaceIndirectShader = [&scene](Shader& shader) {
+		scene.bindBlocks(shader);
+		if (useClustered)
+			ClusteredLighting::bindBlocks(shader);
+		shader.use();
+		shader.setInt("material.textures", 0);
+		if (useShadows)
+			shader.setInt("shadowMap", SHADOW_MAP_UNIT);
+		shader.setFloat("material.shininess", 5.0f);
+	};
+
+	// light properties
+	scene.lights.resize(lightCount);
+	LightData& light = scene.lights[0];
+	light.ambient = glm::vec4(0.2f, 0.2f, 0.2f, 0.0f);
+	light.diffuse = glm::vec4(0.6f, 0.6f, 0.6f, 0.0f);
+	light.specular = glm::vec4(0.8f, 0.8f, 0.8f, 0.0f);
+	light.constant = 0.8f;
+	light.linear = 0.014f;
+	light.quadratic = 0.0007f;
+	light.radius = computeLightRadius(light);
+	// the other lights are small and coloured, spread over rings around the heads
+	std::vector<OrbitingLight> orbits(lightCount);
+	// mt19937 produces the same numbers everywhere, unlike the standard distributions, so they are scaled by hand
+	std::mt19937 random(seed);
+	for (unsigned int i = 1; i < lightCount; i++)
+	{
+		float t = (float)i / (float)lightCount;
+		glm::vec3 color = 0.5f + 0.5f * glm::cos(6.2831853f * (t + glm::vec3(0.0f, 1.0f / 3.0f, 2.0f / 3.0f)));
+		LightData& orbiting = scene.lights[i];
+		orbiting.ambient = glm::vec4(0.0f);
+		orbiting.diffuse = glm::vec4(0.8f * color, 0.0f);
+		orbiting.specular = glm::vec4(0.4f * color, 0.0f);
+		orbiting.constant = 1.0f;
+		orbiting.linear = 2.0f;
+		orbiting.quadratic = 30.0f;
+		orbiting.radius = computeLightRadius(orbiting);
+		orbits[i].orbitRadius = 0.3f + 0.5f * (float)(i % 7) * std::sqrt((float)headCount) / 6.0f;
+		orbits[i].height = -0.3f + 0.1f * (float)(i % 8);
+		orbits[i].phase = 6.2831853f * (float)(random() / 4294967296.0);
+		orbits[i].speed = (i % 2 == 0 ? 1.0f : -1.0f) * (0.5f + (float)(random() / 4294967296.0));
+	}
+	// every light is shown as a wireframe sphere in its colour at full brightness, the orbiting ones smaller
+	std::vector<glm::vec3> gizmoColors(lightCount);
+	std::vector<float> gizmoRadii(lightCount);
+	for (unsigned int i = 0; i < lightCount; i++)
+	{
+		glm::vec3 color(scene.lights[i].diffuse);
+		gizmoColors[i] = color / std::max(color.r, std::max(color.g, color.b));
+		gizmoRadii[i] = i == 0 ? scale : ORBITING_GIZMO_SCALE * scale;
+	}
+
+	// shader for face, compiled per material and for the number of lights
+	if (!useClustered)
+		defines.push_back("NUM_LIGHTS " + std::to_string(lightCount));
+	ShaderVariants faceShaders("face_shader.vs", "face_shader.fs", defines);
+	faceShaders.setInitializer([&scene](Shader& shader) {
+		scene.bindBlocks(shader);
+		if (useClustered)
+			ClusteredLighting::bindBlocks(shader);
+		// material properties, constant for the whole run
+		shader.use();
+		shader.setFloat("material.shininess", 5.0f);
+		if (useShadows)
+			shader.setInt("shadowMap", SHADOW_MAP_UNIT);
+	});
+	// the G-buffer pass of the deferred renderer, specialized per material the same way
+	ShaderVariants gbufferShaders("face_shader.vs", "gbuffer.fs", defines);
+	gbufferShaders.setInitializer(faceShaders.getInitializer());
+	ShaderVariants& headShaders = useDeferred ? gbufferShaders : faceShaders;
+	// the material combinations models usually come with; variants for any other one are built when first drawn
+	headShaders.request(std::vector<std::string>());
+	headShaders.request(std::vector<std::string>(1, "HAS_DIFFUSE_MAP"));
+	std::vector<std::string> diffuseAndSpecular;
+	diffuseAndSpecular.push_back("HAS_DIFFUSE_MAP");
+	diffuseAndSpecular.push_back("HAS_SPECULAR_MAP");
+	headShaders.request(diffuseAndSpecular);
 	
 	// load model for face and shpere
 	// -----------
+	ProfileScope importScope(profiler, "model import");
 	Model Cece(FileSystem::getPath("resources/objects/head_obj/woman1.obj"));
+	importScope.end();
 	Sphere sphere(15, 15);
+	// all the lights' spheres go out in one instanced draw
+	LightGizmos gizmos(sphere);
+
+	// collect the compiled programs
+	sphereShader.finishBuild();
+	setupSphereShader(sphereShader);
+	if (faceIndirectShader)
+	{
+		faceIndirectShader->finishBuild();
+		setupFaceIndirectShader(*faceIndirectShader);
+	}
+	headShaders.finishAll();
+	// and build any variant the model needs that was not requested above now instead of on its first frame
+	for (unsigned int i = 0; i < Cece.meshes.size(); i++)
+		Cece.meshes[i].selectShader(headShaders);
+	std::unique_ptr<DeferredRenderer> deferred;
+	if (useDeferred)
+		deferred.reset(new DeferredRenderer(SCR_WIDTH, SCR_HEIGHT, scene));
+	std::unique_ptr<DynamicResolution> dynamicResolution;
+	if (resolutionTarget > 0.0f)
+		dynamicResolution.reset(new DynamicResolution(resolutionTarget, minResolutionScale));
+	std::unique_ptr<HiZCuller> occlusion;
+	if (occlusionCulling)
+		occlusion.reset(new HiZCuller());
+	std::unique_ptr<PointShadowMap> shadows;
+	if (useShadows)
+		shadows.reset(new PointShadowMap(1024, layeredShadows));
+	startupScope.end();
+	startupTime = glfwGetTime() - startupTime;
+
+	// saved shader files are rebuilt while the program runs, benchmark runs go without the watcher. The sources
+	// in the repository are watched, not the copies the build puts next to the executable
+	ShaderReloader reloader(FileSystem::getPath("src/project/face_with_lighting/"));
+	if (!headless)
+	{
+		reloader.watch(sphereShader, setupSphereShader);
+		reloader.watch(faceShaders);
+		reloader.watch(gbufferShaders);
+		if (deferred)
+		{
+			std::function<void(Shader&)> setupDeferredShaders = [&deferred](Shader&) {
+				deferred->setupShaders();
+			};
+			reloader.watch(deferred->lightShader, setupDeferredShaders);
+			reloader.watch(deferred->compositeShader, setupDeferredShaders);
+		}
+		if (faceIndirectShader)
+			reloader.watch(*faceIndirectShader, setupFaceIndirectShader);
+		if (shadows)
+			reloader.watch(shadows->getShader(), [&shadows](Shader&) {
+				shadows->setupShader();
+			});
+		if (dynamicResolution)
+			reloader.watch(dynamicResolution->upscaleShader, [&dynamicResolution](Shader&) {
+				dynamicResolution->setupShader();
+			});
+		if (occlusion)
+			reloader.watch(occlusion->reduceShader, [&occlusion](Shader&) {
+				occlusion->setupShader();
+			});
+	}
+
+	// positions only, for the depth pre-pass of the render queue
+	Shader depthShader("depth_only.vs", "depth_only.fs");
+	std::function<void(Shader&)> setupDepthShader = [&scene](Shader& shader) {
+		scene.bindBlocks(shader);
+	};
+	setupDepthShader(depthShader);
+	if (!headless)
+		reloader.watch(depthShader, setupDepthShader);
+
+	// all draws of a frame go through the queue, which sorts them by state and depth
+	RenderQueue renderQueue;
+	// the samples of each pass give the overdraw, with and without the pre-pass
+	renderQueue.setCountSamples(true);
+	bool prepassActive = depthPrepass;
+	unsigned int modeFrames = 0;
+	// except the ones into the G-buffer, which go through their own
+	RenderQueue geometryQueue;
+	// and the shadow casters
+	RenderQueue shadowQueue;
+	// the per-cluster light lists, rebuilt every frame on the CPU
+	std::unique_ptr<ClusteredLighting> clusters;
+	if (useClustered)
+		clusters.reset(new ClusteredLighting());
+	float binningTime = 0.0f;
+	// or, for the heads, through one multi-draw
+	std::unique_ptr<IndirectRenderer> indirect;
+	unsigned int ceceHandle = 0;
+	if (useIndirect)
+	{
+		indirect.reset(new IndirectRenderer());
+		ceceHandle = indirect->addModel(Cece);
+	}
+
+	// the heads are static, laid out on a square grid that is centered on the original face
+	std::vector<glm::mat4> heads(headCount);
+	unsigned int columns = (unsigned int)std::ceil(std::sqrt((float)headCount));
+	for (unsigned int i = 0; i < headCount; i++)
+	{
+		float column = (float)(i % columns) - (columns - 1) * 0.5f;
+		float row = (float)(i / columns);
+		glm::mat4 model_face = glm::mat4(1.0f);
+		model_face = glm::translate(model_face, glm::vec3(column, 0.0f, -row));
+		model_face = glm::rotate(model_face, glm::radians(-90.0f), glm::vec3(0,1,0));
+		model_face = glm::scale(model_face, glm::vec3(0.05f * scale));
+		heads[i] = model_face;
+	}
+
+	// a box for every mesh of every head, those of head i from i * meshes on, and a sphere for each light's gizmo
+	FrustumCuller frustumCuller;
+	for (unsigned int i = 0; i < headCount; i++)
+		for (unsigned int j = 0; j < Cece.meshes.size(); j++)
+			frustumCuller.addBox(Cece.meshes[j].aabbMin, Cece.meshes[j].aabbMax, heads[i]);
+	for (unsigned int i = 0; i < lightCount; i++)
+		frustumCuller.addSphere(glm::vec3(0.0f), gizmoRadii[i]);
+	float cullingTime = 0.0f;
+	unsigned long long meshesInView = 0;
+
+	// indices drawn over all frames, for the benchmark's throughput; culled meshes do not count
+	unsigned long long indicesDrawn = 0;
 
 	// variables used in render loop
-	GLuint cnt = 0;
-	GLfloat x, z;
+	unsigned int frameCount = 0;
+	float startTime = glfwGetTime();
+	double scaleSum = 0.0;
+	unsigned long long meshesTested = 0, meshesCulled = 0;
+
+	// the camera and the lights move on their own thread, the loop below draws whatever state they are in.
+	// Benchmark runs step the simulation by a fixed time per frame instead, so every run draws the same frames.
+	Simulation simulation(camera, radius, speed);
+	if (maxFrames == 0)
+		simulation.start();
+
+	// holds each frame back to --fps and collects the frame times
+	FramePacer pacer(targetFps);
 
 	// render loop
 	// -----------
 	while (!glfwWindowShouldClose(window))
 	{
-		// per-frame time logic
-		// --------------------
-		float currentFrame = glfwGetTime();
-		deltaTime = currentFrame - lastFrame;
-		lastFrame = currentFrame;
-		
-		if (sphere_moves == true)
-			cnt++;
-		
+		{
+			ProfileScope pacingScope(profiler, "frame limiter");
+			pacer.wait();
+		}
+		pacer.beginFrame();
+		profiler.beginFrame();
+		ProfileScope frameScope(profiler, "frame");
+
 		// input
 		// -----
-		processInput(window);
+		{
+			ProfileScope inputScope(profiler, "input and shader reload");
+			// in low-latency mode the events are polled here, after the limiter's wait, instead of after the last swap
+			if (lowLatency)
+				glfwPollEvents();
+			processInput(window);
+			simulation.setInput(input);
+			if (!headless)
+				reloader.update();
+		}
+		if (traceRequested)
+		{
+			std::string path = tracePath.empty() ? "trace.json" : tracePath;
+			if (profiler.writeChromeTrace(path))
+				std::cout << "trace of the last " << Profiler::HISTORY_FRAMES << " frames written to " << path << std::endl;
+			traceRequested = false;
+		}
+
+
+		// the simulated camera and sphere at this moment, blended between the last two ticks
+		SimulationState state = maxFrames == 0 ? simulation.getState() : simulation.advanceTo(frameCount * BENCHMARK_FRAME_TIME);
+		Camera view = state.getCamera();
+		glm::vec3 spherePosition = state.getSpherePosition();
+
+		// projection
+		scene.camera.projection = view.GetProjectionMatrix((float)SCR_WIDTH / (float)SCR_HEIGHT, NEAR_PLANE, FAR_PLANE);
+		// camera/view transformation
+		scene.camera.view = view.GetViewMatrix();
+		scene.camera.viewPos = glm::vec4(view.Position, 1.0f);
+		scene.camera.inverseViewProjection = glm::inverse(scene.camera.projection * scene.camera.view);
+		// current light position, used by the face shader to calculate lighting
+		light.position = glm::vec4(spherePosition, 1.0f);
+		glm::vec3 gridCenter(0.0f, 0.0f, -0.5f * (float)((headCount - 1) / columns));
+		for (unsigned int i = 1; i < lightCount; i++)
+		{
+			float angle = orbits[i].phase + (float)state.orbitAngle * orbits[i].speed;
+			scene.lights[i].position = glm::vec4(gridCenter + glm::vec3(orbits[i].orbitRadius * sin(angle), orbits[i].height, orbits[i].orbitRadius * cos(angle)), 1.0f);
+		}
+		int width, height;
+		glfwGetFramebufferSize(window, &width, &height);
+		// the G-buffer stays at the window size, a scaled frame only covers a corner of it
+		if (deferred)
+			deferred->resize(width, height);
 
 		// render
 		// ------
+		// with dynamic resolution the scene is drawn at a lower resolution first and scaled up to the window at the end
+		if (dynamicResolution)
+		{
+			dynamicResolution->begin(width, height);
+			width = dynamicResolution->getWidth();
+			height = dynamicResolution->getHeight();
+			scaleSum += dynamicResolution->getScale();
+		}
 		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+		{
+			ProfileScope uniformsScope(profiler, "uniforms");
+			ring.beginFrame();
+			scene.upload(ring);
+		}
+		if (clusters)
+		{
+			ProfileScope binningScope(profiler, "light binning");
+			float binningStart = glfwGetTime();
+			clusters->update(scene.camera, scene.lights, NEAR_PLANE, FAR_PLANE, width, height);
+			binningTime += glfwGetTime() - binningStart;
+			clusters->upload(ring);
+		}
 
-		// projection
-		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-		// camera/view transformation
-		glm::mat4 view = camera.GetViewMatrix();
+		// Z switches the pre-pass; the counts of the mode being left are printed if it ran long enough for every
+		// query in flight to have been issued in it, earlier ones can still come from the mode before
+		if (depthPrepass != prepassActive)
+		{
+			if (modeFrames >= RenderQueue::getSampleLatency())
+				printOverdraw(renderQueue, prepassActive);
+			prepassActive = depthPrepass;
+			modeFrames = 0;
+		}
+		modeFrames++;
+		// the meshes and the lights' spheres outside the view are left out of the draw lists
+		const unsigned char* meshVisible = NULL;
+		if (frustumCulling)
+		{
+			ProfileScope cullingScope(profiler, "frustum culling");
+			float cullingStart = glfwGetTime();
+			glm::vec4 planes[6];
+			Camera::ExtractFrustumPlanes(scene.camera.projection * scene.camera.view, planes);
+			for (unsigned int i = 0; i < lightCount; i++)
+				frustumCuller.setSphere(i, glm::vec3(scene.lights[i].position), gizmoRadii[i]);
+			frustumCuller.cull(planes);
+			cullingTime += glfwGetTime() - cullingStart;
+			meshVisible = frustumCuller.getBoxVisibility();
+			meshesInView += frustumCuller.getVisibleBoxCount();
+		}
+		const unsigned int meshCount = (unsigned int)Cece.meshes.size();
+		{
+			ProfileScope drawListScope(profiler, "draw lists");
+			renderQueue.setDepthPrepass(depthPrepass && !useDeferred && !useIndirect ? &depthShader : NULL);
+			// the heads are tested against the newest depth pyramid that has come back from the GPU
+			const HiZCuller* culler = occlusion && occlusion->update() ? occlusion.get() : NULL;
+			renderQueue.setOcclusionCuller(culler);
+			geometryQueue.setOcclusionCuller(culler);
+			renderQueue.begin(scene.camera.view, FAR_PLANE);
 		
-		// sphere
-
-		sphereShader.use();
-
-		sphereShader.setMat4("projection", projection);
-		sphereShader.setMat4("view", view);
+			// spheres of the lights, the first one where the simulation has it this frame
+
+			gizmos.begin();
+			for (unsigned int i = 0; i < lightCount; i++)
+				if (!frustumCulling || frustumCuller.isSphereVisible(i))
+					gizmos.add(glm::vec3(scene.lights[i].position), gizmoRadii[i], gizmoColors[i]);
+
+			// faces
+
+			if (useDeferred)
+			{
+				geometryQueue.begin(scene.camera.view, FAR_PLANE);
+				for (unsigned int i = 0; i < headCount; i++)
+					geometryQueue.add(gbufferShaders, Cece, heads[i], meshVisible ? meshVisible + i * meshCount : NULL);
+			}
+			else if (useIndirect)
+			{
+				indirect->begin();
+				// the multi-draw takes whole heads, one is left out only when none of its meshes is in view
+				for (unsigned int i = 0; i < headCount; i++)
+					if (!meshVisible || std::find(meshVisible + i * meshCount, meshVisible + (i + 1) * meshCount, 1) != meshVisible + (i + 1) * meshCount)
+						indirect->add(ceceHandle, heads[i]);
+			}
+			else
+			{
+				for (unsigned int i = 0; i < headCount; i++)
+					renderQueue.add(faceShaders, Cece, heads[i], meshVisible ? meshVisible + i * meshCount : NULL);
+			}
+		}
 
-		glm::mat4 model_sphere = glm::mat4(1.0f);
+		if (useDeferred)
+		{
+			ProfileScope deferredScope(profiler, "deferred shading", true);
+			// the heads go into the G-buffer and every light is added to them from there, forward draws follow on top
+			geometryQueue.sort();
+			deferred->beginGeometryPass(width, height);
+			geometryQueue.submit(ring);
+			deferred->shadeLights((int)scene.lights.size(), dynamicResolution ? dynamicResolution->getFramebuffer() : 0);
+		}
 
-		// sphere rotation around face:
-		if (sphere_moves == true) {
-			// calculate current angle
-			float angle = 0.00001f * cnt * speed;
-			x = radius * sin(angle);
-			z = radius * cos(angle);
+		// the heads never move, so the cached shadow map stays valid for as long as the light is paused
+		if (shadows && shadows->needsUpdate(glm::vec3(light.position), light.radius))
+		{
+			ProfileScope shadowScope(profiler, "shadow map", true);
+			shadowQueue.begin(scene.camera.view, FAR_PLANE);
+			for (unsigned int i = 0; i < headCount; i++)
+				shadowQueue.add(shadows->getShader(), Cece, heads[i]);
+			shadowQueue.sort();
+			shadows->render(glm::vec3(light.position), light.radius, [&shadowQueue, &ring]() {
+				shadowQueue.submit(ring);
+			});
 		}
+		if (shadows)
+			shadows->bind();
 
-		model_sphere = glm::translate(model_sphere, glm::vec3(x, 0.0, z));	// translate sphere for rotation using the x and y calculated for this frame
-		model_sphere = glm::scale(model_sphere, glm::vec3(1.0f * scale));		// scale sphere so that it fit the window
-		sphereShader.setMat4("model", model_sphere);
+		{
+			ProfileScope sortScope(profiler, "sort");
+			renderQueue.sort();
+		}
+		{
+			ProfileScope drawScope(profiler, "draws", true);
+			renderQueue.submit(ring);
+			if (useIndirect)
+				indicesDrawn += indirect->submit(*faceIndirectShader, ring);
+			gizmos.submit(sphereShader, ring);
+		}
+		indicesDrawn += renderQueue.getIndexCount() + (useDeferred ? geometryQueue.getIndexCount() : 0)
+			+ (unsigned long long)sphere.Indices.size() * gizmos.getCount();
+		if (occlusion)
+		{
+			ProfileScope pyramidScope(profiler, "depth pyramid", true);
+			occlusion->capture(dynamicResolution ? dynamicResolution->getFramebuffer() : 0, width, height, scene.camera.projection * scene.camera.view);
+			meshesTested += renderQueue.getMeshCount() + geometryQueue.getMeshCount();
+			meshesCulled += renderQueue.getCulledCount() + geometryQueue.getCulledCount();
+		}
+		if (dynamicResolution)
+		{
+			ProfileScope upscaleScope(profiler, "upscale", true);
+			dynamicResolution->end();
+		}
+		ring.endFrame();
+		
+		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+		// -------------------------------------------------------------------------------
+		{
+			ProfileScope swapScope(profiler, "swap");
+			glfwSwapBuffers(window);
+			// waiting for the GPU keeps the driver from queueing frames, each one is shown right after it was drawn
+			if (lowLatency)
+				glFinish();
+			else
+				glfwPollEvents();
+		}
 
-		sphere.Draw(); //draw model
+		if (maxFrames != 0 && ++frameCount >= maxFrames)
+			glfwSetWindowShouldClose(window, true);
+	}
 
-		// face
+	if (maxFrames != 0)
+	{
+		glFinish();
+		float elapsed = glfwGetTime() - startTime;
+		std::cout << "startup (shaders and model): " << startupTime * 1000.0f << " ms" << std::endl;
+		std::cout << "frames: " << frameCount << ", heads: " << headCount
+			<< (useDeferred ? " (deferred)" : useIndirect ? " (indirect)" : " (render queue)") << ", lights: " << lightCount
+			<< (useClustered ? " (clustered)" : "")
+			<< (legacyNormals ? ", per-vertex normal matrix" : ", CPU normal matrix")
+			<< ", average frame time: " << elapsed * 1000.0f / frameCount << " ms"
+			<< ", index throughput: " << indicesDrawn / elapsed / 1.0e6 << " M indices/s" << std::endl;
+		if (shadows)
+			std::cout << "shadow map renders: " << shadows->getRenderCount() << " in " << frameCount << " frames"
+				<< (shadows->isLayered() ? " (layered)" : " (six passes)") << std::endl;
+		if (!useDeferred && !useIndirect)
+			printOverdraw(renderQueue, depthPrepass);
+		if (dynamicResolution)
+			std::cout << "dynamic resolution: average scale " << scaleSum / frameCount << ", GPU time of the last measured frame "
+				<< dynamicResolution->getGpuTime() << " ms (target " << resolutionTarget << " ms)" << std::endl;
+		if (frustumCulling)
+			std::cout << "frustum culling: " << (double)meshesInView / frameCount << " of " << frustumCuller.getBoxCount()
+				<< " head meshes in view per frame on average, " << cullingTime * 1000.0f / frameCount << " ms per frame" << std::endl;
+		if (occlusion)
+			std::cout << "occlusion culling: " << (double)meshesCulled / frameCount << " of " << (double)meshesTested / frameCount
+				<< " head meshes culled per frame on average" << std::endl;
+		if (clusters)
+			std::cout << "light binning: " << binningTime * 1000.0f / frameCount << " ms per frame, "
+				<< clusters->getIndexCount() << " light list entries in the last frame" << std::endl;
+	}
 
-		faceShader.use();
+	if (pacer.getFrameCount() > 0)
+		std::cout << "frame times over the last " << pacer.getFrameCount() << " frames: median " << pacer.getPercentile(0.5)
+			<< " ms, 90% " << pacer.getPercentile(0.9) << " ms, 99% " << pacer.getPercentile(0.99)
+			<< " ms, max " << pacer.getPercentile(1.0) << " ms" << std::endl;
 
-		faceShader.setMat4("projection", projection);
-		faceShader.setMat4("view", view);
+	if (!tracePath.empty() && profiler.writeChromeTrace(tracePath))
+		std::cout << "trace of the last " << Profiler::HISTORY_FRAMES << " frames written to " << tracePath << std::endl;
 
-		glm::mat4 model_face = glm::mat4(1.0f);
-		model_face = glm::rotate(model_face, glm::radians(-90.0f), glm::vec3(0,1,0));
-		model_face = glm::scale(model_face, glm::vec3(0.05f * scale));
-		faceShader.setMat4("model", model_face);
-		
-		// parameters for lighting
-		faceShader.setVec3("light.position", glm::vec3(x, 0.0, z)); // give current light position to face fragment shader to calculate lighting 
-		faceShader.setVec3("viewPos", camera.Position);
-
-		// light properties
-		faceShader.setVec3("light.ambient", 0.2f, 0.2f, 0.2f);
-		faceShader.setVec3("light.diffuse", 0.6f, 0.6f, 0.6f);
-		faceShader.setVec3("light.specular", 0.8f, 0.8f, 0.8f);
-		faceShader.setFloat("light.constant", 0.8f);
-		faceShader.setFloat("light.linear", 0.014f);
-		faceShader.setFloat("light.quadratic", 0.0007f);
-
-		// material properties
-		faceShader.setFloat("material.shininess", 5.0f);
-
-		Cece.Draw(faceShader);
-		
-		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-		// -------------------------------------------------------------------------------
-		glfwSwapBuffers(window);
-		glfwPollEvents();
-	}
+	std::cout << "GL state changes: " << GLState::getIssuedCalls() << " issued, " << GLState::getFilteredCalls() << " filtered as redundant" << std::endl;
 
 	// glfw: terminate, clearing all previously allocated GLFW resources.
 	// ------------------------------------------------------------------
@@ -187,36 +722,118 @@ int main()
 	return 0;
 }
 
-// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
+// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly;
+// the keys that move things are only collected in input, the simulation acts on them on every tick
 // ---------------------------------------------------------------------------------------------------------
 void processInput(GLFWwindow* window)
 {
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)		// close window with ESC
 		glfwSetWindowShouldClose(window, true);
+	input.keys = 0;
 	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)			// move forward with W
-		camera.ProcessKeyboard(FORWARD, deltaTime);
+		input.keys |= KEY_FORWARD;
 	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)			// move backward with S
-		camera.ProcessKeyboard(BACKWARD, deltaTime);
+		input.keys |= KEY_BACKWARD;
 	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)			// move left with A
-		camera.ProcessKeyboard(LEFT, deltaTime);
+		input.keys |= KEY_LEFT;
 	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)			// move right with D
-		camera.ProcessKeyboard(RIGHT, deltaTime);
+		input.keys |= KEY_RIGHT;
 	if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)			// move the sphere away from the face with UP
-		radius += 0.01f * scale;
+		input.keys |= KEY_SPHERE_AWAY;
 	if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)		// bring the sphere closer with DOWN
-		radius -= 0.01f * scale;
+		input.keys |= KEY_SPHERE_CLOSER;
 	if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS)			// pause the sphere with P
-		sphere_moves = false;
+		input.keys |= KEY_PAUSE;
 	if (glfwGetKey(window, GLFW_KEY_U) == GLFW_PRESS)			// unpause with U
-		sphere_moves = true;
+		input.keys |= KEY_RESUME;
 	if (glfwGetKey(window, GLFW_KEY_J) == GLFW_PRESS)			// increase speed of sphere with J
-		speed += 0.05;
+		input.keys |= KEY_FASTER;
 	if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS)			// decrease speed of sphere with H
+		input.keys |= KEY_SLOWER;
+	// toggle the depth pre-pass with Z, once per key press
+	static bool zPressed = false;
+	bool zDown = glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS;
+	if (zDown && !zPressed)
+		depthPrepass = !depthPrepass;
+	zPressed = zDown;
+	// write the profiler's trace with T
+	static bool tPressed = false;
+	bool tDown = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+	if (tDown && !tPressed)
+		traceRequested = true;
+	tPressed = tDown;
+
+}
+
+// prints how many fragments the render queue shaded per covered pixel, from its occlusion queries
+// ---------------------------------------------------------------------------------------------------------
+void printOverdraw(const RenderQueue& queue, bool prepass)
+{
+	GLuint shaded = queue.getSamples(RenderQueue::PASS_OPAQUE);
+	std::cout << "depth pre-pass " << (prepass ? "on" : "off") << ": " << shaded << " fragments shaded";
+	if (prepass)
 	{
-		speed -= 0.05;
-		if (speed < 0.0) speed = 0.0;
+		// every visible pixel of the heads passes the depth pass at least once and the equal pass exactly once
+		GLuint depthSamples = queue.getSamples(RenderQueue::PASS_DEPTH);
+		std::cout << ", " << depthSamples << " in the depth pass";
+		if (shaded > 0)
+			std::cout << ", depth pass overdraw: " << (float)depthSamples / shaded;
 	}
+	std::cout << std::endl;
+}
 
+// reads the command line options into the globals above
+// ---------------------------------------------------------------------------------------------------------
+void parseArguments(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--headless") == 0)
+			headless = true;
+		else if (std::strcmp(argv[i], "--indirect") == 0)
+			useIndirect = true;
+		else if (std::strcmp(argv[i], "--legacy-normals") == 0)
+			legacyNormals = true;
+		else if (std::strcmp(argv[i], "--deferred") == 0)
+			useDeferred = true;
+		else if (std::strcmp(argv[i], "--clustered") == 0)
+			useClustered = true;
+		else if (std::strcmp(argv[i], "--no-shadows") == 0)
+			useShadows = false;
+		else if (std::strcmp(argv[i], "--six-pass-shadows") == 0)
+			layeredShadows = false;
+		else if (std::strcmp(argv[i], "--depth-prepass") == 0)
+			depthPrepass = true;
+		else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			seed = (unsigned int)std::strtoul(argv[++i], NULL, 10);
+		else if (std::strcmp(argv[i], "--dynamic-resolution") == 0 && i + 1 < argc)
+			resolutionTarget = (float)std::max(0.0, std::atof(argv[++i]));
+		else if (std::strcmp(argv[i], "--min-resolution-scale") == 0 && i + 1 < argc)
+			minResolutionScale = (float)std::atof(argv[++i]);
+		else if (std::strcmp(argv[i], "--no-frustum-culling") == 0)
+			frustumCulling = false;
+		else if (std::strcmp(argv[i], "--occlusion-culling") == 0)
+			occlusionCulling = true;
+		else if (std::strcmp(argv[i], "--low-latency") == 0)
+			lowLatency = true;
+		else if (std::strcmp(argv[i], "--swap-interval") == 0 && i + 1 < argc)
+		{
+			swapInterval = std::max(-1, std::min(std::atoi(argv[++i]), 4));
+			swapIntervalSet = true;
+		}
+		else if (std::strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+			targetFps = (float)std::max(0.0, std::atof(argv[++i]));
+		else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+			tracePath = argv[++i];
+		else if (std::strcmp(argv[i], "--lights") == 0 && i + 1 < argc)
+			lightCount = (unsigned int)std::max(1, std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			maxFrames = (unsigned int)std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--heads") == 0 && i + 1 < argc)
+			headCount = (unsigned int)std::max(1, std::atoi(argv[++i]));
+		else
+			std::cout << "Unknown option: " << argv[i] << std::endl;
+	}
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -245,14 +862,15 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 	lastX = xpos;
 	lastY = ypos;
 
-	camera.ProcessMouseMovement(xoffset, yoffset);
+	input.mouseX += xoffset;
+	input.mouseY += yoffset;
 }
 
 // glfw: whenever the mouse scroll wheel scrolls, this callback is called
 // ----------------------------------------------------------------------
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
-	camera.ProcessMouseScroll(yoffset);
+	input.scroll += yoffset;
 }
 
 
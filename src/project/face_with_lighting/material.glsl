@@ -0,0 +1,30 @@
+// the per-mesh material of the face shaders, compiled per material:
+// HAS_DIFFUSE_MAP and HAS_SPECULAR_MAP are defined for meshes that have those maps
+struct Material {
+    sampler2DArray textures;    // all textures of the model, one per layer
+    int diffuseLayer;
+    int specularLayer;
+    vec3 diffuseColor;
+    float shininess;
+}; 
+
+uniform Material material;
+
+vec3 materialDiffuse(vec2 texCoords)
+{
+    vec3 diffuseColor = material.diffuseColor;
+#ifdef HAS_DIFFUSE_MAP
+    diffuseColor *= texture(material.textures, vec3(texCoords, material.diffuseLayer)).rgb;
+#endif
+    return diffuseColor;
+}
+
+// meshes without a specular map reflect their diffuse color
+vec3 materialSpecular(vec2 texCoords, vec3 diffuseColor)
+{
+#ifdef HAS_SPECULAR_MAP
+    return texture(material.textures, vec3(texCoords, material.specularLayer)).rgb;
+#else
+    return diffuseColor;
+#endif
+}
@@ -0,0 +1,9 @@
+// world space normal. LEGACY_NORMAL_MATRIX inverts the model matrix per vertex instead, for comparing the two.
+vec3 transformNormal(mat4 model, mat3 normalMatrix, vec3 normal)
+{
+#ifdef LEGACY_NORMAL_MATRIX
+    return mat3(transpose(inverse(model))) * normal;
+#else
+    return normalMatrix * normal;
+#endif
+}
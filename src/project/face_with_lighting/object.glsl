@@ -0,0 +1,7 @@
+// per-draw data of the forward shaders, see ObjectBlock in SceneUniforms.h
+layout (std140) uniform Object {
+    mat4 model;
+    mat3 normalMatrix;  // transpose(inverse(mat3(model))), computed on the CPU
+};
+
+#include "normals.glsl"
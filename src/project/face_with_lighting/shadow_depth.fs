@@ -0,0 +1,11 @@
+#version 330 core
+// stores the distance to the light, divided by the far plane, as the depth of the cube map
+in vec3 FragPos;
+
+uniform vec3 lightPosition;
+uniform float farPlane;
+
+void main()
+{
+    gl_FragDepth = length(FragPos - lightPosition) / farPlane;
+}
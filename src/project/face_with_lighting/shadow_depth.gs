@@ -0,0 +1,23 @@
+#version 330 core
+// renders every caster triangle into all six faces of the cube map in one pass
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 18) out;
+
+out vec3 FragPos;
+
+uniform mat4 faceMatrices[6];
+
+void main()
+{
+    for (int face = 0; face < 6; face++)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            gl_Layer = face;
+            FragPos = gl_in[i].gl_Position.xyz;
+            gl_Position = faceMatrices[face] * gl_in[i].gl_Position;
+            EmitVertex();
+        }
+        EndPrimitive();
+    }
+}
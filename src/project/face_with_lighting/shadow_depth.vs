@@ -0,0 +1,22 @@
+#version 330 core
+// shadow casters of PointShadowMap, in world space for the geometry shader, or projected onto one cube face
+layout (location = 0) in vec3 aPos;
+
+#include "object.glsl"
+
+#ifdef LAYERED
+void main()
+{
+    gl_Position = model * vec4(aPos, 1.0);
+}
+#else
+out vec3 FragPos;
+
+uniform mat4 faceMatrix;
+
+void main()
+{
+    FragPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = faceMatrix * vec4(FragPos, 1.0);
+}
+#endif
@@ -0,0 +1,25 @@
+#version 330 core
+// scales the dynamic resolution target up to the window: bilinear, then an unsharp mask against the four
+// neighbouring texels brings back some of the edges lost to the lower resolution
+out vec4 FragColor;
+
+uniform sampler2D scene;
+uniform vec2 scale;         // the part of the target the scene was drawn into
+uniform vec2 windowSize;
+uniform float sharpness;    // 0 at full resolution
+
+vec3 fetch(vec2 uv, vec2 texel)
+{
+    // keeps the filter from reaching into the part of the target that was not drawn this frame
+    return texture(scene, min(uv, scale - 0.5 * texel)).rgb;
+}
+
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(scene, 0));
+    vec2 uv = gl_FragCoord.xy / windowSize * scale;
+    vec3 center = fetch(uv, texel);
+    vec3 neighbours = fetch(uv + vec2(texel.x, 0.0), texel) + fetch(uv - vec2(texel.x, 0.0), texel)
+                    + fetch(uv + vec2(0.0, texel.y), texel) + fetch(uv - vec2(0.0, texel.y), texel);
+    FragColor = vec4(clamp(center + sharpness * (4.0 * center - neighbours), 0.0, 1.0), 1.0);
+}